@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "allocator.h"
+#include "btrie.h"
+#include "bufmgr.h"
+#include "db.h"
+#include "dim.h"
+
+using namespace std;
+
+/**
+ * Microbenchmark for searches in a single level BTrie, comparing searching for
+ * each key on its own (`DB::BTrie::find`) with searching for sorted batches of
+ * keys (`DB::BTrie::findMany`).
+ *
+ * Usage: bin/probes [keys in the BTrie] [keys per batch] [number of batches]
+ */
+
+namespace {
+  using Clock = chrono::steady_clock;
+
+  double
+  seconds(Clock::time_point since)
+  {
+    return chrono::duration<double>(Clock::now() - since).count();
+  }
+
+  void
+  report(const char *name, long probes, double secs, long check)
+  {
+    cout << name << ": " << (long)(probes / secs) << " probes/s"
+         << " (checksum " << check << ")" << endl;
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  int size    = argc > 1 ? atoi(argv[1]) : 1000000;
+  int batch   = argc > 2 ? atoi(argv[2]) : 1024;
+  int batches = argc > 3 ? atoi(argv[3]) : 2000;
+
+  try {
+    DB::Allocator a(DB::Dim::NAME,
+                    DB::Dim::PAGE_SIZE,
+                    DB::Dim::NUM_PAGES);
+
+    DB::BufMgr    b(DB::Dim::POOL_SIZE);
+
+    DB::Global::ALLOC  = &a;
+    DB::Global::BUFMGR = &b;
+
+    cout << "Building BTrie of " << size << " keys..." << endl;
+    mt19937 gen(1);
+    DB::page_id root = DB::BTrie::leaf(1);
+    for (int i = 0; i < size; ++i) {
+      DB::page_id lid; int pos;
+      auto split = DB::BTrie::reserve(root, gen() % (4 * size), DB::NO_SIBS,
+                                      lid, pos);
+
+      if (split.prop == DB::PROP_SPLIT)
+        root = DB::BTrie::branch(root, split.key, split.pid);
+    }
+
+    vector<vector<DB::Key>> keys(batches, vector<DB::Key>(batch));
+    for (auto &keyBatch : keys)
+      for (DB::Key &key : keyBatch)
+        key = gen() % (4 * size);
+
+    long probes = (long)batch * batches;
+    vector<DB::page_id> pids;
+    vector<int>         pos;
+
+    Clock::time_point start = Clock::now();
+    long check = 0;
+    for (const auto &keyBatch : keys)
+      for (DB::Key key : keyBatch) {
+        DB::page_id pid; int p;
+        DB::BTrie::find(root, key, pid, p);
+        check += p;
+      }
+    report("find    ", probes, seconds(start), check);
+
+    start = Clock::now();
+    check = 0;
+    for (auto keyBatch : keys) {
+      sort(keyBatch.begin(), keyBatch.end());
+      DB::BTrie::findMany(root, keyBatch, pids, pos);
+      for (int p : pos) check += p;
+    }
+    report("findMany", probes, seconds(start), check);
+
+  } catch(exception &e){
+    cerr << "\n\nprobes terminated due to exception: "
+         << e.what() << endl;
+  }
+  return 0;
+}
@@ -50,6 +50,18 @@ namespace DB {
      */
     page_id palloc(unsigned num);
 
+    /**
+     * Allocator::pallocBetween
+     *
+     * Allocate the first free page whose ID falls in a range.
+     *
+     * @param from The smallest page ID to consider (inclusive).
+     * @param to   The largest page ID to consider (exclusive).
+     * @return The page ID of the page allocated, or INVALID_PAGE if every page
+     *         in the range is already allocated.
+     */
+    page_id pallocBetween(page_id from, page_id to);
+
     /**
      * Allocator::pfree
      *
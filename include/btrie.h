@@ -3,21 +3,53 @@
 
 #include <cstddef>
 #include <cstring>
-#include <functional>
+#include <limits>
 #include <stdexcept>
+#include <vector>
 
 #include "allocator.h"
 #include "db.h"
+#include "defrag_report.h"
+#include "dim.h"
+#include "key.h"
+#include "page_versions.h"
 #include "trie.h"
 
 namespace DB {
+  struct Snapshot;
+
   /**
    * BTrie
    *
-   * Implementation of the Nested BTrie Index (specialised to always hold
-   * records with two columns). In this implementation, all nodes perform
-   * redistribution after deletions, but only leaf nodes perform redistributions
-   * after insertions.
+   * Implementation of the Nested BTrie Index. Each level of nesting is a BTrie
+   * in its own right, whose leaves map keys to the roots of the BTries at the
+   * next level (the last level holds only keys). In this implementation, all
+   * nodes perform redistribution after deletions, but only leaf nodes perform
+   * redistributions after insertions.
+   *
+   * Nodes are laid out column-wise: the keys of all slots are stored
+   * contiguously at the start of the data section, followed by their values
+   * (the page IDs of sub-indices in leaves, or of children in branches), and
+   * any further columns. This keeps searches within a node from touching
+   * values they do not need, and lets them be vectorised.
+   *
+   * Sub-indices with at most `Dim::INLINE_SIZE` keys are not given pages of
+   * their own, but are stored inline, in the columns following the value in
+   * their parent's leaf slot. In this case, the value holds the negation of
+   * the number of keys in the sub-index (page IDs are never negative).
+   *
+   * Branches also record the number of keys in the subtree under each child, in
+   * the column after the child's page ID, and their total in the header. The
+   * root of every BTrie therefore knows how many keys it holds, and the
+   * position of a key in the BTrie (or the key at a position) can be found in
+   * a single descent.
+   *
+   * An index has at most one writer at a time, but readers of snapshots may
+   * search and iterate over it concurrently, without latches: each node keeps
+   * a version, which the writer bumps when it publishes an old version of the
+   * node for readers, before changing it. Readers that found the live node
+   * check that its version is unchanged after reading it, and otherwise retry
+   * the read against the old version (see `BTrie::Reader`).
    */
   struct BTrie {
     /**
@@ -28,7 +60,7 @@ namespace DB {
      */
     struct Diff {
       Propagate prop;
-      int key;
+      Key key;
 
       union {
         page_id pid;
@@ -36,6 +68,79 @@ namespace DB {
       };
     };
 
+    /**
+     * BTrie::Defrag
+     *
+     * Where a pass of `BTrie::defragment` over the leaves of a BTrie is up to.
+     * A fresh pass starts from the first leaf.
+     */
+    struct Defrag {
+      Key     key  = std::numeric_limits<Key>::min(); // The smallest key in
+                                                      // the leaves to visit.
+      page_id last = INVALID_PAGE; // The page the last leaf visited is in,
+      page_id was  = INVALID_PAGE; // and the page it was in before.
+    };
+
+    /**
+     * BTrie::Writer
+     *
+     * Guard for modifications to an index that may be being read from a
+     * snapshot. Whilst it is alive, every node loaded is first preserved in the
+     * given store of page versions, so that readers of older versions can
+     * still find its current contents after it has been changed.
+     */
+    struct Writer {
+      Writer(PageVersions *versions);
+      ~Writer();
+
+      Writer(const Writer &) = delete;
+      Writer & operator = (const Writer &) = delete;
+
+    private:
+      PageVersions *mPrev;
+    };
+
+    /**
+     * BTrie::Reader
+     *
+     * Guard for reading a node as a snapshot sees it, without latching it.
+     * When the snapshot sees an old version of the node, that copy is pinned,
+     * and never changes. When it sees the live node, the table's writer may be
+     * changing it concurrently, so anything read through the guard is only to
+     * be trusted if `isValid` holds once reading is done. Otherwise, the read
+     * should be retried with a fresh guard, which will find the old version
+     * the writer published before making its change. Pages are pinned for
+     * snapshots through `BufMgr::pinForReader`, so that the writer may free
+     * the live node whilst the guard still holds it.
+     *
+     * Without a snapshot, the node is simply loaded, and always valid.
+     */
+    struct Reader {
+      Reader(page_id nid, const Snapshot *snapshot);
+      ~Reader();
+
+      Reader(const Reader &) = delete;
+      Reader & operator = (const Reader &) = delete;
+
+      inline BTrie *get()        const { return mNode; }
+      inline BTrie *operator->() const { return mNode; }
+
+      /**
+       * BTrie::Reader::isValid
+       *
+       * @return True iff the node has not been changed since the guard was
+       *         created.
+       */
+      bool isValid() const;
+
+    private:
+      page_id  mPID;     // The page pinned by the guard.
+      BTrie   *mNode;
+      bool     mIsLive;  // Whether a writer may change the page under us.
+      unsigned mVersion; // The page's version when the guard was created.
+      bool     mIsShared; // Whether the page is pinned for a snapshot reader.
+    };
+
     /**
      * BTrie::leaf
      *
@@ -58,27 +163,42 @@ namespace DB {
      *         keys(left) <= key < keys(right) should hold for this branch to be
      *         a valid BTrie Node.
      */
-    static page_id branch(page_id left, int key, page_id right);
+    static page_id branch(page_id left, Key key, page_id right);
 
     /**
-     * BTrie::onHeap
+     * BTrie::freeSize
      *
-     * Create a free-standing BTrie node, outside of database managed pages, in
-     * just enough memory to hold the required number of slots at the given size.
-     *
-     * @param stride The size of each slot
+     * @param stride The size of each slot.
      * @param size   The number of slots.
+     * @return The number of bytes a free-standing node (see `BTrie::freeNode`)
+     *         needs to hold the required number of slots at the given size.
+     */
+    static constexpr std::size_t freeSize(int stride, int size)
+    {
+      return offsetof(BTrie, data) + (size * stride + stride - 1) * sizeof(Key);
+    }
+
+    /**
+     * BTrie::freeNode
+     *
+     * Create a free-standing BTrie leaf, outside of database managed pages, in
+     * memory provided by the caller (which may be part of another object, so
+     * that no allocation is needed).
      *
-     * @return A pointer to memory allocated on the heap holding the node. It is
-     *         returned as a char pointer because that is how it is allocated,
-     *         and how it should be freed (using delete[]).
+     * @param buf    The memory to create the node in, aligned as a BTrie, and
+     *               at least `freeSize(stride, size)` bytes long.
+     * @param stride The size of each slot.
+     * @param size   The number of slots.
+     * @return A pointer to the node, which shares its lifetime with `buf`.
      */
-    static char * onHeap(int stride, int size);
+    static BTrie *freeNode(char *buf, int stride, int size);
 
     /**
      * BTrie::load
      *
-     * Load a page in and cast it as a BTrie.
+     * Load a page in and cast it as a BTrie. If a `Writer` is active, the page
+     * is preserved before it is returned, and if that made a copy of it, its
+     * version is bumped, as the caller is expected to change it.
      *
      * @param nid The Page ID of the node.
      * @return The pointer to the page, as a BTrie.
@@ -106,12 +226,18 @@ namespace DB {
      * @param &keyPos Set to the position in the node where the slot can be
      *                found.
      *
+     * @param appendFill The percentage of slots kept by full nodes that are
+     *                   split by an insertion past the last key of the tree,
+     *                   instead of splitting them evenly, so that append-style
+     *                   loads fill their nodes.
+     *
      * @return An update for the caller. Reserving a slot for the key may cause
      *         a node to be split, or redistributed, in which case the caller
      *         must update its records to reflect that.
      */
-    static Diff reserve(page_id nid, int key, Siblings sibs,
-                        page_id &pid, int &keyPos);
+    static Diff reserve(page_id nid, Key key, Siblings sibs,
+                        page_id &pid, int &keyPos,
+                        int appendFill = Dim::APPEND_FILL);
 
     /**
      * BTrie::deleteIf
@@ -126,15 +252,52 @@ namespace DB {
      * @param family Information about the node's siblings in its parent node.
      *
      * @param predicate Function used to determine whether the key should be
-     * deleted.
+     * deleted. It is called with the page ID of the leaf holding the key, and
+     * the key's position in it. It is a template parameter, so that it may be
+     * inlined into the search.
      *
      * @return An update for the caller. Deleting a slot may cause the node to
      *         be merged or redistributed, which should be reflected in its
-     *         parent.
+     *         parent. At the root, `PROP_MERGE` signals that the root may have
+     *         been left empty, and should be replaced by its only child.
      */
-    static Diff deleteIf(page_id nid, int key,
+    template <typename Predicate>
+    static Diff deleteIf(page_id nid, Key key,
                          Family family,
-                         std::function<bool(page_id, int)> predicate);
+                         Predicate &&predicate);
+
+    /**
+     * BTrie::deleteRange
+     *
+     * Remove the keys in a range from the first leaf that holds any of them,
+     * shifting the rest of the leaf down once, and rebalancing it once, rather
+     * than once for each key. Keys in the range that are in later leaves are
+     * left for further calls, which the caller makes until `more` is false.
+     *
+     * @param nid     The page id of the node to look in.
+     *
+     * @param &lo     The smallest key to delete. If there may be keys left to
+     *                delete, it is updated to the first of them.
+     *
+     * @param hi      The largest key to delete.
+     *
+     * @param family  Information about the node's siblings in its parent node.
+     *
+     * @param destroy Function called for each key before it is deleted, with
+     * the page ID of the leaf holding the key, and the key's position in it.
+     *
+     * @param &removed Set to the number of keys deleted.
+     *
+     * @param &more   Set to whether keys in the range may be left in the next
+     *                leaf.
+     *
+     * @return An update for the caller, as with `deleteIf`.
+     */
+    template <typename Callback>
+    static Diff deleteRange(page_id nid, Key &lo, Key hi,
+                            Family family,
+                            Callback &&destroy,
+                            int &removed, bool &more);
 
     /**
      * BTrie::find
@@ -148,8 +311,115 @@ namespace DB {
      *                  leaf.
      * @param &foundPos The reference that will be set to the position in the
      *                  leaf to find the key at.
+     * @param snapshot  If given, every page ID (including `nid` and
+     *                  `foundPID`) is as referenced from within the trie, and
+     *                  is resolved through this snapshot before it is loaded.
+     *                  Nodes are read optimistically, so the search may run
+     *                  whilst the table's writer changes the trie.
+     */
+    static void find(page_id nid, Key key, page_id &foundPID, int &foundPos,
+                     const Snapshot *snapshot = nullptr);
+
+    /**
+     * BTrie::findMany
+     *
+     * Find the leaf slots for many keys at once, as `BTrie::find` would for
+     * each of them. The tree is walked once: each node on the paths to the
+     * keys is visited (and pinned) once, and its keys are split between its
+     * children, rather than each key being searched for from the root.
+     *
+     * @param nid        The page ID of the root node of the BTrie to search in.
+     * @param keys       The search keys, in ascending order.
+     * @param &foundPIDs Resized to hold the page ID of the leaf for each key.
+     * @param &foundPos  Resized to hold the position in its leaf to find each
+     *                   key at.
+     * @param snapshot   If given, page IDs are resolved through this snapshot,
+     *                   as for `BTrie::find`.
+     */
+    static void findMany(page_id nid, const std::vector<Key> &keys,
+                         std::vector<page_id> &foundPIDs,
+                         std::vector<int> &foundPos,
+                         const Snapshot *snapshot = nullptr);
+
+    /**
+     * BTrie::defragment
+     *
+     * Continue a pass over the leaves of a BTrie in key order, moving each
+     * leaf that is out of place to the first free page after the leaf before
+     * it, as long as that is nearer to it than its current page (or it is
+     * before that leaf), and updating its parent and neighbours to point to its
+     * new page. Over a whole pass, the leaves are moved into ascending page
+     * order, in runs of adjacent pages where there is room. The root is never
+     * moved.
+     *
+     * @param nid     The page ID of the root node of the BTrie.
+     * @param &pass   Where the pass is up to, which is updated as it goes, and
+     *                reset once the pass reaches the last leaf.
+     * @param budget  The most leaves to visit.
+     * @param &report The leaves visited and moved are added to this report.
+     * @return True iff the pass reached the last leaf.
+     */
+    static bool defragment(page_id nid, Defrag &pass, int budget,
+                           DefragReport &report);
+
+    /**
+     * BTrie::copy
+     *
+     * Copy the version of a node that a snapshot sees, validating the copy
+     * against concurrent changes made by the table's writer (see
+     * `BTrie::Reader`).
+     *
+     * @param nid      The page ID of the node, as referenced from within the
+     *                 trie.
+     * @param snapshot The snapshot being read from.
+     * @param dst      Buffer the node is copied into, of `Dim::PAGE_SIZE`
+     *                 bytes.
+     */
+    static void copy(page_id nid, const Snapshot *snapshot, BTrie *dst);
+
+    /**
+     * BTrie::destroy
+     *
+     * Free every page in a BTrie, along with every page in the sub-indices
+     * nested beneath it. No rebalancing is done along the way, so this costs
+     * time proportional to the number of pages freed.
+     *
+     * @param nid The page ID of the root node of the BTrie.
+     */
+    static void destroy(page_id nid);
+
+    /**
+     * BTrie::size
+     *
+     * @param nid The page ID of the root node of the BTrie.
+     * @return The number of keys in the BTrie (not counting the keys in its
+     *         sub-indices).
      */
-    static void find(page_id nid, int key, page_id &foundPID, int &foundPos);
+    static int size(page_id nid);
+
+    /**
+     * BTrie::rank
+     *
+     * @param nid The page ID of the root node of the BTrie.
+     * @param key The search key.
+     * @return The number of keys in the BTrie strictly less than `key`.
+     */
+    static int rank(page_id nid, Key key);
+
+    /**
+     * BTrie::select
+     *
+     * Find the key at a given position in the BTrie's sorted order.
+     *
+     * @param nid       The page ID of the root node of the BTrie.
+     * @param index     The position of the key (0-based). Must be less than the
+     *                  size of the BTrie.
+     * @param &foundPID The reference that will be set to the page_id of the
+     *                  leaf holding the key.
+     * @param &foundPos The reference that will be set to the position of the
+     *                  key in that leaf.
+     */
+    static void select(page_id nid, int index, page_id &foundPID, int &foundPos);
 
     /**
      * BTrie::split
@@ -159,11 +429,13 @@ namespace DB {
      * @param pid    The page ID corresponding to this node
      * @param &pivot A reference that will be filled with the index at which
      *               the node was split.
+     * @param fill   The percentage of slots this node keeps (it always keeps
+     *               atleast half).
      *
      * @return A struct containing the the key in the middle of the split, and
      *         the ID of the new page.
      */
-    Diff split(page_id pid, int &pivot);
+    Diff split(page_id pid, int &pivot, int fill = 50);
 
     /**
      * BTrie::merge
@@ -178,7 +450,24 @@ namespace DB {
      * @param part The key that partitions these two nodes (When merging
      *             branches this needs to be added back in).
      */
-    void merge(page_id nid, BTrie *that, int part);
+    void merge(page_id nid, BTrie *that, Key part);
+
+    /**
+     * BTrie::gallop
+     *
+     * Search this node for a key, starting from a given slot, by galloping:
+     * stepping over slots in strides that double each time, until one lands
+     * past the key, and then searching the last stride as in `findKey`. This
+     * is quicker than searching the whole node when the key is likely to be
+     * close by.
+     *
+     * @param searchKey The key to search for.
+     * @param from      The slot to start from. Every key before it is assumed
+     *                  to be less than the search key.
+     * @return The index of the slot corresponding to the smallest key greater
+     *         than or equal to the one provided.
+     */
+    int gallop(Key searchKey, int from);
 
     /**
      * BTrie::getType
@@ -194,6 +483,13 @@ namespace DB {
      */
     int getCount() const;
 
+    /**
+     * BTrie::getTotal
+     *
+     * @return The number of keys in the subtree rooted at this node.
+     */
+    int getTotal() const;
+
     /**
      * BTrie::getPrev
      *
@@ -225,24 +521,112 @@ namespace DB {
     /**
      * BTrie::isUnderOccupied
      *
-     * Check if more than half the nodes are empty.
+     * Check if at most `Dim::MERGE_FILL` percent of the node's slots are
+     * filled, so that it should be rebalanced with a sibling.
      */
     bool isUnderOccupied() const;
 
     /**
-     * BTrie::slot
+     * BTrie::canAbsorb
+     *
+     * @param that The node's right sibling.
+     * @return True iff the sibling's slots would all fit in this node, if they
+     *         were merged.
+     */
+    bool canAbsorb(const BTrie *that) const;
+
+    /**
+     * BTrie::key
+     *
+     * @param index The slot index.
+     * @return A reference to the key in the slot at the given index.
+     */
+    inline Key &key(int index) { return data[index]; }
+
+    /**
+     * BTrie::val
+     *
+     * In leaves, this is the value associated with the key (only present when
+     * the stride is greater than 1). In branches, this is the page ID of the
+     * child to the right of the key, and the left-most child may be found at
+     * index -1.
+     *
+     * @param index The slot index.
+     * @return A reference to the value in the slot at the given index.
+     */
+    inline Key &val(int index) { return col(1, index); }
+
+    /**
+     * BTrie::weight
+     *
+     * @param index The slot index (in a branch, so may be -1).
+     * @return A reference to the number of keys in the subtree under the child
+     *         at the given index.
+     */
+    inline Key &weight(int index) { return col(2, index); }
+
+    /**
+     * BTrie::col
      *
-     * Get the pointer to the slot at a given index.
+     * Every column other than the keys has room for an extra entry at index
+     * -1 (used by branches to hold their left-most child).
      *
+     * @param c     The column (0 for keys, 1 for values, and so on).
      * @param index The slot index.
+     * @return A reference to the given column of the slot at the given index.
      */
-    int *slot(int index);
+    inline Key &col(int c, int index) { return data[c * (cap + 1) + index]; }
+
+    /**
+     * BTrie::inlineCount
+     *
+     * @param index The slot index (in a leaf).
+     * @return The number of keys in the sub-index held inline in the slot, or
+     *         0 if the slot holds the page ID of its sub-index instead.
+     */
+    int inlineCount(int index);
+
+    /**
+     * BTrie::setInlineCount
+     *
+     * Mark the slot as holding its sub-index inline.
+     *
+     * @param index The slot index (in a leaf).
+     * @param n     The number of keys in the inline sub-index (must be
+     *              positive).
+     */
+    void setInlineCount(int index, int n);
+
+    /**
+     * BTrie::inlineKey
+     *
+     * @param index The slot index (in a leaf).
+     * @param j     The position of the key in the inline sub-index.
+     * @return A reference to the key.
+     */
+    inline Key &inlineKey(int index, int j) { return col(2 + j, index); }
+
+    /**
+     * BTrie::unpack
+     *
+     * Copy the sub-index held inline in a slot into a free-standing leaf (as
+     * created by `BTrie::freeNode`), so that it can be traversed like any other
+     * leaf.
+     *
+     * @param index The slot index (in a leaf).
+     * @param dst   The free-standing leaf. It must have room for
+     *              `Dim::INLINE_SIZE` slots.
+     */
+    void unpack(int index, BTrie *dst);
 
   private:
 
+    static const int SPACE;
+    static const int SCAN_WIDTH;
     static const int BRANCH_STRIDE;
-    static const int BRANCH_SPACE;
-    static const int LEAF_SPACE;
+
+    // Versions of the index being written to (by this thread).
+    static thread_local PageVersions *sVersions;
 
     /**
      * BTrie::BTrie
@@ -253,29 +637,127 @@ namespace DB {
     BTrie() = default;
 
     NodeType type;
+    int      count;
+    unsigned version; // Bumped whenever an old version of the node is
+                      // published for readers, before the node is changed.
+    int      stride;  // Number of columns in a slot.
+    int      cap;    // Number of slots that fit in the node.
+    int      total;  // Number of keys in the subtree (only kept by branches).
+    page_id  prev, next;
+    Key      data[1];
 
-    int count;
-    page_id prev, next;
+    /**
+     * (private) BTrie::capacity
+     *
+     * @param stride The number of columns in a slot.
+     * @return The number of slots that fit in a page, when every slot has the
+     *         given number of columns.
+     */
+    static int capacity(int stride);
 
-    union {
-      struct {
-        int data[1];
-      } b;
+    /**
+     * (private) BTrie::recount
+     *
+     * Recompute a branch's total from the weights of its children, after slots
+     * have been moved in or out of it.
+     */
+    void recount();
 
-      struct {
-        int stride;
-        int data[1];
-      } l;
-    };
+    /**
+     * (private) BTrie::deleteSlot
+     *
+     * The part of `deleteIf` (and `deleteRange`) that does not depend on the
+     * predicate: Remove a run of slots from a leaf, and redistribute or merge
+     * the leaf if it becomes under occupied.
+     *
+     * @param nid    The page ID of the leaf.
+     * @param node   The (pinned) leaf. It is unpinned by this function.
+     * @param pos    The position of the first slot to remove.
+     * @param family Information about the node's siblings in its parent node.
+     * @param n      The number of slots to remove (defaults to 1).
+     * @return An update for the caller, as with `deleteIf`.
+     */
+    static Diff deleteSlot(page_id nid, BTrie *node, int pos, Family family,
+                           int n = 1);
+
+    /**
+     * (private) BTrie::fixChild
+     *
+     * The part of `deleteIf` that does not depend on the predicate: Update a
+     * branch to reflect a deletion in one of its children, and redistribute or
+     * merge the branch if it becomes under occupied.
+     *
+     * @param nid       The page ID of the branch.
+     * @param node      The (pinned) branch. It is unpinned by this function.
+     * @param pos       The position of the key the child is to the left of.
+     * @param family    Information about the node's siblings in its parent.
+     * @param childDiff The update returned from the child.
+     * @param removed   The number of keys removed from under the child
+     *                  (defaults to 1).
+     * @return An update for the caller, as with `deleteIf`.
+     */
+    static Diff fixChild(page_id nid, BTrie *node, int pos, Family family,
+                         Diff childDiff, int removed = 1);
+
+    /**
+     * (private) BTrie::moveSlots
+     *
+     * Move the keys and values of a run of slots from one node to another (or
+     * within the same node). Both nodes must have the same stride. This
+     * dispatches on the stride once, to a version of the move specialised for
+     * it.
+     *
+     * @param dst    The node to move slots to.
+     * @param dstIdx The index of the first slot to write to in `dst`.
+     * @param src    The node to move slots from.
+     * @param srcIdx The index of the first slot to read from in `src`.
+     * @param n      The number of slots to move.
+     */
+    static void moveSlots(BTrie *dst, int dstIdx, BTrie *src, int srcIdx, int n);
+
+    /**
+     * (private) BTrie::moveSlots<Stride>
+     *
+     * As above, for nodes whose stride is known at compile time.
+     */
+    template <int Stride>
+    static void moveSlots(BTrie *dst, int dstIdx, BTrie *src, int srcIdx, int n);
+
+    /**
+     * (private) BTrie::findMany
+     *
+     * As above, for the `n` keys starting at `keys`, writing the results for
+     * each key to the same offset from `foundPIDs` and `foundPos`.
+     */
+    static void findMany(page_id nid, const Key *keys, int n,
+                         page_id *foundPIDs, int *foundPos,
+                         const Snapshot *snapshot);
 
     /**
      * (private) BTrie::findKey
      *
-     * @param key The key to search for.
+     * Binary search narrows the range of candidate slots, until it is at most
+     * SCAN_WIDTH wide, at which point it is scanned linearly (using SIMD
+     * comparisons, when they are available).
+     *
+     * @param searchKey The key to search for.
      * @return The index of the slot in the node corresponding to the smallest
      *         key greater than or equal to the one provided.
      */
-    int findKey(int key);
+    int findKey(Key searchKey);
+
+    /**
+     * (private) BTrie::scanKeys
+     *
+     * The linear part of `findKey`.
+     *
+     * @param searchKey The key to search for.
+     * @param lo        The first slot that may hold the key.
+     * @param hi        The slot after the last that may hold the key.
+     * @return The index of the slot in `[lo, hi]` corresponding to the
+     *         smallest key greater than or equal to the one provided.
+     */
+    int scanKeys(Key searchKey, int lo, int hi);
 
     /**
      * (private) BTrie::makeRoom
@@ -288,6 +770,117 @@ namespace DB {
      */
     void makeRoom(int index, int size = 1);
   };
+
+  template <typename Predicate>
+  BTrie::Diff
+  BTrie::deleteIf(page_id nid, Key key,
+                  Family family,
+                  Predicate &&predicate)
+  {
+    BTrie * node = load(nid);
+    int     pos  = node->findKey(key);
+
+    switch (node->type) {
+    case Leaf:
+      if (pos == node->count
+          || node->key(pos) != key
+          || !predicate(nid, pos)
+          ) {
+        Global::BUFMGR->unpin(nid);
+
+        Diff diff = {};
+        diff.prop = PROP_NOTHING;
+        return diff;
+      }
+
+      return deleteSlot(nid, node, pos, family);
+    case Branch: {
+      page_id childPID = node->val(pos - 1);
+
+      Family childFamily {};
+      if (pos > 0) {
+        childFamily.sibs    |= LEFT_SIB;
+        childFamily.leftKey  = &node->key(pos - 1);
+      }
+
+      if (pos < node->count) {
+        childFamily.sibs |= RIGHT_SIB;
+        childFamily.rightKey = &node->key(pos);
+      }
+
+      // Traverse the appropriate child.
+      Diff childDiff = deleteIf(childPID, key, childFamily, predicate);
+      return fixChild(nid, node, pos, family, childDiff);
+    }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
+  }
+
+  template <typename Callback>
+  BTrie::Diff
+  BTrie::deleteRange(page_id nid, Key &lo, Key hi,
+                     Family family,
+                     Callback &&destroy,
+                     int &removed, bool &more)
+  {
+    BTrie * node = load(nid);
+    int     pos  = node->findKey(lo);
+
+    switch (node->type) {
+    case Leaf: {
+      int end = pos;
+      for (; end < node->count && node->key(end) <= hi; ++end)
+        destroy(nid, end);
+
+      // If the range runs off the end of the leaf, it may carry on from the
+      // first key of the next one (which is found before the leaf changes).
+      more = false;
+      if (end == node->count && node->next != INVALID_PAGE) {
+        page_id nextPID = node->next;
+        BTrie * next    = (BTrie *)Global::BUFMGR->pin(nextPID);
+
+        if (next->count > 0 && next->key(0) <= hi) {
+          lo   = next->key(0);
+          more = true;
+        }
+
+        Global::BUFMGR->unpin(nextPID);
+      }
+
+      removed = end - pos;
+      if (removed == 0) {
+        Global::BUFMGR->unpin(nid);
+
+        Diff diff = {};
+        diff.prop = PROP_NOTHING;
+        return diff;
+      }
+
+      return deleteSlot(nid, node, pos, family, removed);
+    }
+    case Branch: {
+      page_id childPID = node->val(pos - 1);
+
+      Family childFamily {};
+      if (pos > 0) {
+        childFamily.sibs    |= LEFT_SIB;
+        childFamily.leftKey  = &node->key(pos - 1);
+      }
+
+      if (pos < node->count) {
+        childFamily.sibs |= RIGHT_SIB;
+        childFamily.rightKey = &node->key(pos);
+      }
+
+      Diff childDiff = deleteRange(childPID, lo, hi, childFamily, destroy,
+                                   removed, more);
+      return fixChild(nid, node, pos, family, childDiff, removed);
+    }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
+  }
 }
 
 #endif // DB_BTRIE_H
@@ -1,11 +1,14 @@
 #ifndef DB_BTRIE_ITERATOR_H
 #define DB_BTRIE_ITERATOR_H
 
-#include <stack>
-#include <tuple>
+#include <memory>
+#include <vector>
 
 #include "allocator.h"
 #include "btrie.h"
+#include "container.h"
+#include "dim.h"
+#include "snapshot.h"
 #include "trie_iterator.h"
 
 namespace DB {
@@ -13,24 +16,35 @@ namespace DB {
    * BTrieIterator
    *
    * A Trie Iterator for traversing data stored in Nested B+-Tries.
+   *
+   * When reading from a snapshot, the iterator does not hold on to pages in
+   * between calls, as the table's writer may change or free them. Instead, it
+   * reads each leaf into a private copy, and remembers pages by the IDs they
+   * are referenced by in the trie, resolving them through the snapshot each
+   * time they are read. Reads are validated against the writer's concurrent
+   * changes (see `BTrie::Reader`), so the iterator may be used on another
+   * thread than the writer's.
    */
   struct BTrieIterator : public TrieIterator {
 
     /**
      * BTrieIterator::BTrieIterator
      *
-     * Construct a brand new trie iterator for a 2-column B+ Trie. The iterator
+     * Construct a brand new trie iterator for a Nested B+ Trie. The iterator
      * starts at depth -1.
      *
      * @param rootPID The page_id for the root node of the BTrie being iterated over.
-     * @param fst     The position of the table's 1st parameter in the ordering.
-     * @param snd     The position of the table's 2nd parameter in the ordering. It
-     *                is assumed that fst < snd. That is to say, a table must
-     *                contain two different query paramaters, with the first
-     *                appearing before the second, always. (There is no restriction
-     *                on the values held in these columns).
+     * @param order   The position in the global ordering of each level of the
+     *                trie. It is assumed that these are strictly increasing.
+     *                That is to say, a table must contain different query
+     *                parameters at each level, with each level's parameter
+     *                appearing before the next's, always. (There is no
+     *                restriction on the values held in these columns).
+     * @param snapshot If given, the iterator reads the trie as it was when the
+     *                 snapshot was taken, and keeps the snapshot alive.
      */
-    BTrieIterator(page_id rootPID, int fst, int snd);
+    BTrieIterator(page_id rootPID, const std::vector<int> &order,
+                  std::shared_ptr<const Snapshot> snapshot = nullptr);
 
     /**
      * BTrieIterator::~BTrieIterator
@@ -48,31 +62,87 @@ namespace DB {
     void open()               override;
     void up()                 override;
     void next()               override;
-    void seek(int searchKey)  override;
+    void seek(Key searchKey)  override;
 
-    int  key()          const override;
+    Key  key()          const override;
     bool atEnd()        const override;
     bool atValidDepth() const override;
 
+    bool bits(Bits &out) const override;
+
   private:
-    const int mFst; // The position of the 1st column in the global ordering.
-    const int mSnd; // The position of the 2nd column in the global ordering.
+    /**
+     * (private) BTrieIterator::Ancestor
+     *
+     * A leaf the iterator has been through to get to the node at its current
+     * depth.
+     */
+    struct Ancestor {
+      page_id pid;   // The leaf's page (INVALID_PAGE above the top level).
+      BTrie * node;  // The leaf, kept pinned (or copied) whilst below it.
+      int     pos;   // The offset of the cursor in the leaf.
+      int     depth; // The depth of the leaf.
+      page_id root;  // The root of the sub-index opened from the cursor.
+    };
 
-    BTrie * const mDummy; // A dummy node used for storing the leaf node "at
-                          // depth -1".
+    // Whether each position in the global ordering has a level of the trie.
+    std::vector<bool> mIsValid;
 
-    // A history of leaf pages the iterator has been through to get to the node
-    // at its current depth. For each page, we store the offset in that page,
-    // and the depth of the node.
-    std::stack<std::tuple<page_id, int, int>> mHistory;
+    // The snapshot being read from, if any.
+    std::shared_ptr<const Snapshot> mSnapshot;
+
+    page_id mRootPID; // The root of the top level of the trie.
+
+    // A free-standing leaf that inline sub-indices are unpacked into, for
+    // traversal, and the memory it is held in.
+    alignas(BTrie) char mInlineBuf[BTrie::freeSize(1, Dim::INLINE_SIZE)];
+    BTrie * const mInline;
+
+    // Copies of the leaves at each level, when reading from a snapshot (null
+    // otherwise).
+    char * const mCopies;
+
+    // The leaves the iterator has been through to get to the node at its
+    // current depth. There is room for one per level of the trie, made when
+    // the iterator is constructed, so that opening and going back up do not
+    // allocate, and the leaves stay pinned, so that going back up to them does
+    // not pin them again.
+    std::vector<Ancestor> mPath;
 
     int mCurrDepth; // The actual depth of the iterator
     int mNodeDepth; // The last depth the iterator participated in.
 
-    // Cursor state.
+    // Cursor state (with no node above the top level).
     page_id mPID;
     BTrie * mCurr;
     int     mPos;
+
+    // Cursor state when the current node is a container (otherwise null), in
+    // which case the cursor is at key `mBoxKey`, unless `mBoxEnd` is set.
+    const Container * mBox;
+    Key               mBoxKey;
+    bool              mBoxEnd;
+
+    /**
+     * (private) BTrieIterator::hold
+     *
+     * Make a leaf (or container) the iterator's current node. When reading
+     * from a snapshot, the version of the leaf the snapshot sees is copied
+     * (into the copy for the current level), otherwise the leaf is kept
+     * pinned.
+     *
+     * @param pid  The ID of the leaf, as referenced from within the trie.
+     * @param leaf The leaf, if the caller has already pinned it (only when not
+     *             reading from a snapshot).
+     */
+    void hold(page_id pid, BTrie *leaf = nullptr);
+
+    /**
+     * (private) BTrieIterator::release
+     *
+     * Let go of the iterator's current node.
+     */
+    void release();
   };
 }
 
@@ -1,6 +1,11 @@
 #ifndef DB_BUFMGR_H
 #define DB_BUFMGR_H
 
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "allocator.h"
 #include "frame.h"
 #include "replacer.h"
@@ -10,7 +15,8 @@ namespace DB {
    * BufMgr
    *
    * Manages a cache of pages from the database file that are resident in main
-   * memory.
+   * memory. Pages may be pinned, unpinned, allocated and freed from several
+   * threads at once.
    */
   struct BufMgr {
     /**
@@ -43,6 +49,19 @@ namespace DB {
      */
     char *pin(page_id pid, bool isEmpty = false);
 
+    /**
+     * BufMgr::pinForReader
+     *
+     * Pin the page on behalf of a snapshot reader, which reads it without
+     * latching, and may be on another thread than the one changing it. The
+     * writer may free the page whilst such pins are held (see `bfree`).
+     *
+     * @param pid The page ID to pin.
+     * @return A pointer to the page's data, or nullptr if it could not be
+     *         pinned.
+     */
+    char *pinForReader(page_id pid);
+
     /**
      * BufMgr::unpin
      *
@@ -56,6 +75,16 @@ namespace DB {
      */
     void unpin(page_id pid, bool dirty = false);
 
+    /**
+     * BufMgr::unpinForReader
+     *
+     * Release a pin taken by `pinForReader`. It is an error to call this
+     * function on pages that no reader has pinned.
+     *
+     * @param pid The page ID to be unpinned.
+     */
+    void unpinForReader(page_id pid);
+
     /**
      * BufMgr::bnew
      *
@@ -72,12 +101,29 @@ namespace DB {
      */
     page_id bnew(char *&first, int howMany = 1);
 
+    /**
+     * BufMgr::bnewBetween
+     *
+     * Allocate the first free page whose ID falls in a range, and pin it.
+     *
+     * @param page A reference that is populated with the pointer to the page's
+     *             data if the operation was a success, and with nullptr
+     *             otherwise.
+     * @param from The smallest page ID to consider (inclusive).
+     * @param to   The largest page ID to consider (exclusive).
+     * @return The page ID of the page allocated, or INVALID_PAGE if there was
+     *         no free page in the range.
+     */
+    page_id bnewBetween(char *&page, page_id from, page_id to);
+
     /**
      * BufMgr::bfree
      *
      * Free the memory allocated for the page in the buffer, and deallocate it
-     * on file. This operation cannot be performed if the pin count on the page
-     * is greater than 0.
+     * on file. It is an error to free a page that is pinned, unless every pin
+     * on it was taken by `pinForReader` (readers that have yet to notice the
+     * page is gone), in which case the page is freed when the last of them
+     * unpins it, and is not reused until then.
      *
      * @param pid The page ID of the page to free.
      */
@@ -98,10 +144,31 @@ namespace DB {
     Replacer mReplacer;
     int      mPoolSize;
 
+    std::recursive_mutex            mLatch;
+    std::unordered_set<page_id>     mDoomed;  // Freed pages readers still pin.
+    std::unordered_map<page_id,int> mFrameOf; // Frame of each resident page.
+    std::vector<int>                mEmpty;   // Frames holding no page.
+
+    /**
+     * (private) BufMgr::pinFrame
+     *
+     * Pin the page, as `pin` does, tagging the pin as a reader's if asked.
+     */
+    char *pinFrame(page_id pid, bool isEmpty, bool reader);
+
+    /**
+     * (private) BufMgr::unpinFrame
+     *
+     * Unpin the page, as `unpin` does, releasing a reader's pin if asked.
+     */
+    void unpinFrame(page_id pid, bool dirty, bool reader);
+
     /**
      * (private) BufMgr::findFrame
      *
      * Search for a frame in the buffer pool that could contain the given page.
+     * Resident pages are looked up in a table, rather than by searching the
+     * pool, so this takes constant time.
      *
      * @param pid the page ID to find
      * @return If the page is already in the pool, then return the frame it is
@@ -109,6 +176,18 @@ namespace DB {
      *         index. Failing that, we return INVALID_FRAME.
      */
     int findFrame(page_id pid);
+
+    /**
+     * (private) BufMgr::emptyFrame
+     *
+     * Remove the page from the given frame, and make the frame available to the
+     * next page that is pinned.
+     *
+     * @param fid       The index of the frame, which must hold a page.
+     * @param writeBack Whether the page should be written back to file first,
+     *                  if it is dirty.
+     */
+    void emptyFrame(int fid, bool writeBack);
   };
 }
 
@@ -0,0 +1,194 @@
+#ifndef DB_CONTAINER_H
+#define DB_CONTAINER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "allocator.h"
+#include "key.h"
+#include "trie.h"
+
+namespace DB {
+  /**
+   * Container
+   *
+   * A sub-index at the last level of a table, held in a single page, in an
+   * encoding more compact than the sorted keys of a BTrie leaf, for when its
+   * keys are dense:
+   *
+   *  - `Bitmap` containers hold a bit for every value in a span of `BITS`
+   *    values. Spans start at multiples of 64, so that the words of any two
+   *    bitmaps line up.
+   *  - `Runs` containers hold the first and last value of each maximal run of
+   *    consecutive keys, in order.
+   *
+   * The header starts with the same fields as a BTrie node's (its type, its
+   * number of keys, then its version), so that the type and size of a
+   * sub-index can be read from its root, however it is held, and so that
+   * containers can be read concurrently with their writer, like any node.
+   */
+  struct Container {
+    static const int WORDS;     // Words in a bitmap.
+    static const int BITS;      // Values spanned by a bitmap.
+    static const int MAX_RUNS;  // Runs that fit in a page.
+    static const int MIN_COUNT; // Fewest keys worth keeping in a container.
+
+    /**
+     * Container::isContainer
+     *
+     * @param type The type of a node.
+     * @return True iff nodes of this type are containers.
+     */
+    static bool isContainer(NodeType type);
+
+    /**
+     * Container::build
+     *
+     * Create a container holding the given keys, as a bitmap if they fit in
+     * its span, or as runs otherwise.
+     *
+     * @param keys The keys, sorted and without duplicates.
+     * @return The page ID of the new container, or `INVALID_PAGE` if neither
+     *         encoding can hold the keys.
+     */
+    static page_id build(const std::vector<Key> &keys);
+
+    /**
+     * Container::load
+     *
+     * Load a container's page. Pages are loaded through `BTrie::load`, so that
+     * an active `BTrie::Writer` preserves them, as it does the rest of the
+     * index.
+     *
+     * @param pid The page ID of the container.
+     * @return The pointer to the page, as a Container.
+     */
+    static Container *load(page_id pid);
+
+    /**
+     * Container::insert
+     *
+     * @param key        The key to add.
+     * @param &didChange Set to true iff the key was not already present.
+     * @return False iff the key could not be added without changing the
+     *         container's encoding (in which case it is left as it was).
+     */
+    bool insert(Key key, bool &didChange);
+
+    /**
+     * Container::remove
+     *
+     * @param key        The key to remove.
+     * @param &didChange Set to true iff the key was present.
+     * @return False iff the key could not be removed without changing the
+     *         container's encoding (in which case it is left as it was).
+     */
+    bool remove(Key key, bool &didChange);
+
+    /**
+     * Container::seek
+     *
+     * @param key    The search key.
+     * @param &found Set to the smallest key in the container greater than or
+     *               equal to `key`, if there is one.
+     * @return True iff there is such a key.
+     */
+    bool seek(Key key, Key &found) const;
+
+    /**
+     * Container::keys
+     *
+     * @param &out Buffer that the container's keys are appended to, in order.
+     */
+    void keys(std::vector<Key> &out) const;
+
+    /**
+     * Container::getType
+     *
+     * @return The container's encoding.
+     */
+    NodeType getType() const;
+
+    /**
+     * Container::getCount
+     *
+     * @return The number of keys in the container.
+     */
+    int getCount() const;
+
+    /**
+     * Container::getBase
+     *
+     * @return The value of the first bit in a bitmap's span.
+     */
+    Key getBase() const;
+
+    /**
+     * Container::getWords
+     *
+     * @return The `WORDS` words of a bitmap. Bit `i` of word `w` is set iff
+     *         `getBase() + 64 * w + i` is in the container.
+     */
+    const uint64_t *getWords() const;
+
+  private:
+
+    static const int SPACE;
+
+    /**
+     * Container::Container
+     *
+     * Default constructor. Made private so that Container's static functions
+     * must be used to create instances.
+     */
+    Container() = default;
+
+    NodeType type;
+    int      count;
+    unsigned version;
+    Key      base; // Value of the first bit (Bitmap).
+    int      runs; // Number of runs (Runs).
+    alignas(uint64_t) Key data[1];
+
+    /**
+     * (private) Container::words
+     *
+     * @return The words of a bitmap.
+     */
+    inline uint64_t *words() { return (uint64_t *)data; }
+
+    /**
+     * (private) Container::first / Container::last
+     *
+     * @param run The index of a run.
+     * @return A reference to the first (last) value in the run.
+     */
+    inline Key &first(int run) { return data[2 * run]; }
+    inline Key &last(int run)  { return data[2 * run + 1]; }
+
+    inline Key first(int run) const { return data[2 * run]; }
+    inline Key last(int run)  const { return data[2 * run + 1]; }
+
+    /**
+     * (private) Container::findRun
+     *
+     * @param key The search key.
+     * @return The index of the first run whose last value is greater than or
+     *         equal to `key`.
+     */
+    int findRun(Key key) const;
+
+    /**
+     * (private) Container::makeRoom
+     *
+     * Make space for new runs at the given index (or remove runs, when `size`
+     * is negative). This function does not make sure there is enough room.
+     *
+     * @param index The position at which to make room.
+     * @param size  Number of runs to make room for.
+     */
+    void makeRoom(int index, int size);
+  };
+}
+
+#endif // DB_CONTAINER_H
@@ -0,0 +1,112 @@
+#ifndef DB_CSR_ITERATOR_H
+#define DB_CSR_ITERATOR_H
+
+#include <vector>
+
+#include "csr_trie.h"
+#include "trie_iterator.h"
+
+namespace DB {
+  /**
+   * CSRIterator
+   *
+   * A Trie Iterator for traversing data stored in a CSRTrie. At each level, it
+   * keeps a cursor into the trie's arrays, which skips over keys whose records
+   * have all been removed, and a cursor into its sorted delta, and presents
+   * the smaller of their keys. Seeks gallop through the arrays.
+   */
+  struct CSRIterator : public TrieIterator {
+
+    /**
+     * CSRIterator::CSRIterator
+     *
+     * Construct an iterator for a CSRTrie. The iterator starts at depth -1.
+     *
+     * @param trie  The trie to traverse. Its behaviour is undefined if the
+     *              trie is modified whilst the iterator is in use.
+     * @param order The position in the global ordering of each level of the
+     *              trie, in ascending order.
+     */
+    CSRIterator(const CSRTrie &trie, const std::vector<int> &order);
+
+    /** Deleted Copy Constructors */
+    CSRIterator(const CSRIterator &) = delete;
+    CSRIterator & operator = (const CSRIterator &) = delete;
+
+    /** TrieIterator method overrides */
+
+    void open()               override;
+    void up()                 override;
+    void next()               override;
+    void seek(Key searchKey)  override;
+
+    Key  key()          const override;
+    bool atEnd()        const override;
+    bool atValidDepth() const override;
+
+  private:
+    const CSRTrie &mTrie;
+
+    // Whether each position in the global ordering has a level of the trie.
+    std::vector<bool> mIsValid;
+
+    int mCurrDepth; // The depth of the iterator in the global ordering.
+    int mLevel;     // The level of the trie the iterator is at.
+
+    // Cursor state for each level: ranges of the keys in the arrays, of the
+    // records in the delta, and of the removed records, that share the prefix
+    // at the levels above.
+    std::vector<int> mBasePos, mBaseEnd;
+    std::vector<int> mInsPos,  mInsEnd;
+    std::vector<int> mDelPos,  mDelEnd;
+
+    /**
+     * (private) CSRIterator::baseKey
+     *
+     * @return The key under the cursor into the arrays at the current level, or
+     *         the largest key if it has finished.
+     */
+    Key baseKey() const;
+
+    /**
+     * (private) CSRIterator::insKey
+     *
+     * @return The key under the cursor into the delta at the current level, or
+     *         the largest key if it has finished.
+     */
+    Key insKey() const;
+
+    /**
+     * (private) CSRIterator::skipRemoved
+     *
+     * Move the cursor into the arrays at the current level past any keys whose
+     * records have all been removed.
+     */
+    void skipRemoved();
+
+    /**
+     * (private) CSRIterator::upperBound
+     *
+     * @param recs  A sorted list of records.
+     * @param from  The start of a range of the list, sharing a prefix above
+     *              the current level.
+     * @param to    The end of the range.
+     * @param key   A key.
+     * @return The position of the first record in the range whose key at the
+     *         current level is greater than `key`.
+     */
+    int upperBound(const std::vector<CSRTrie::Record> &recs,
+                   int from, int to, Key key) const;
+
+    /**
+     * (private) CSRIterator::lowerBound
+     *
+     * As `CSRIterator::upperBound`, but finds the first record whose key at the
+     * current level is no less than `key`.
+     */
+    int lowerBound(const std::vector<CSRTrie::Record> &recs,
+                   int from, int to, Key key) const;
+  };
+}
+
+#endif // DB_CSR_ITERATOR_H
@@ -0,0 +1,177 @@
+#ifndef DB_CSR_TRIE_H
+#define DB_CSR_TRIE_H
+
+#include <vector>
+
+#include "key.h"
+
+namespace DB {
+  /**
+   * CSRTrie
+   *
+   * An in-memory trie of fixed width records, stored as one sorted array of
+   * keys per level, in the style of a Compressed Sparse Row matrix: the
+   * children of the `i`th key at level `l` are the keys at level `l + 1` with
+   * positions in the range [offsets(l)[i], offsets(l)[i + 1]).
+   *
+   * Records are passed in level order. The arrays are rebuilt only
+   * occasionally: in between, inserted records are kept in a small sorted
+   * delta, and removed records are marked by a sorted list of tombstones. Once
+   * these grow to `Dim::DELTA_SIZE` records (or the square root of the size of
+   * the arrays, if that is larger, to balance the cost of updating the delta
+   * against that of rebuilding), they are merged into the arrays.
+   */
+  struct CSRTrie {
+    using Record = std::vector<Key>;
+
+    /**
+     * CSRTrie::CSRTrie
+     *
+     * Construct an empty trie.
+     *
+     * @param width The number of levels in the trie.
+     */
+    CSRTrie(int width);
+
+    /** Deleted copy constructors */
+    CSRTrie(const CSRTrie &) = delete;
+    CSRTrie & operator = (const CSRTrie &) = delete;
+
+    /**
+     * CSRTrie::insert
+     *
+     * @param rec The record to insert, in level order.
+     * @return True iff the insertion changed the trie.
+     */
+    bool insert(const Record &rec);
+
+    /**
+     * CSRTrie::insertBatch
+     *
+     * Insert many records at once, by merging them with the trie's records
+     * and rebuilding the arrays, rather than through the delta.
+     *
+     * @param recs   The records to insert, in level order, in ascending order,
+     *               without duplicates, one after the other.
+     * @param &added Buffer that the records that were not already in the trie
+     *               are appended to, in the same form.
+     */
+    void insertBatch(const std::vector<Key> &recs, std::vector<Key> &added);
+
+    /**
+     * CSRTrie::remove
+     *
+     * @param rec The record to remove, in level order.
+     * @return True iff the deletion changed the trie.
+     */
+    bool remove(const Record &rec);
+
+    /**
+     * CSRTrie::removeRange
+     *
+     * Remove every record whose key at a given level falls in a range. At the
+     * first level, the records form a span of each array, which is cut out in
+     * place, otherwise the arrays are rebuilt without them.
+     *
+     * @param level The level whose keys are compared against the range.
+     * @param lo    The smallest key to remove (inclusive).
+     * @param hi    The largest key to remove (inclusive).
+     * @return The number of records removed.
+     */
+    int removeRange(int level, Key lo, Key hi);
+
+    /**
+     * CSRTrie::records
+     *
+     * @return Every record in the trie, in ascending order, one after the
+     *         other in a single buffer.
+     */
+    std::vector<Key> records() const;
+
+    /**
+     * CSRTrie::getWidth
+     *
+     * @return The number of levels in the trie.
+     */
+    int getWidth() const;
+
+    /**
+     * CSRTrie::keys
+     *
+     * @param level A level of the trie.
+     * @return The sorted keys of the nodes at the given level.
+     */
+    const std::vector<Key> &keys(int level) const;
+
+    /**
+     * CSRTrie::offsets
+     *
+     * @param level A level of the trie, other than the last.
+     * @return The position of each node's first child in the next level, and
+     *         a final entry for the end of the next level.
+     */
+    const std::vector<int> &offsets(int level) const;
+
+    /**
+     * CSRTrie::inserted
+     *
+     * @return The records inserted since the arrays were last rebuilt, sorted.
+     */
+    const std::vector<Record> &inserted() const;
+
+    /**
+     * CSRTrie::deleted
+     *
+     * @return The records removed from the arrays since they were last
+     *         rebuilt, sorted.
+     */
+    const std::vector<Record> &deleted() const;
+
+    /**
+     * CSRTrie::leafCount
+     *
+     * @param level The level of a node in the arrays.
+     * @param pos   The position of the node in its level.
+     * @return The number of records in the arrays that start with the node's
+     *         prefix, including any that have since been removed.
+     */
+    int leafCount(int level, int pos) const;
+
+  private:
+    int                            mWidth;
+    std::vector<std::vector<Key>>  mKeys;
+    std::vector<std::vector<int>>  mOffsets;
+    std::vector<Record>            mInserted;
+    std::vector<Record>            mDeleted;
+
+    /**
+     * (private) CSRTrie::inBase
+     *
+     * @param rec A record, in level order.
+     * @return True iff the record is in the arrays (whether or not it has
+     *         since been removed).
+     */
+    bool inBase(const Record &rec) const;
+
+    /**
+     * (private) CSRTrie::compactIfFull
+     *
+     * Merge the delta and tombstones into the arrays, if there are enough of
+     * them.
+     */
+    void compactIfFull();
+
+    /**
+     * (private) CSRTrie::build
+     *
+     * Replace the arrays with ones holding the given records, and clear the
+     * delta and tombstones.
+     *
+     * @param recs The records, in ascending order, without duplicates, one
+     *             after the other.
+     */
+    void build(const std::vector<Key> &recs);
+  };
+}
+
+#endif // DB_CSR_TRIE_H
@@ -0,0 +1,24 @@
+#ifndef DB_DEFRAG_REPORT_H
+#define DB_DEFRAG_REPORT_H
+
+namespace DB {
+  /**
+   * DefragReport
+   *
+   * An account of the work done by a call to `Table::defragment`. A leaf is
+   * out of place if it is not in the page after the one holding the leaf
+   * before it, in key order (so that scanning from one to the other means
+   * seeking in the database file), and the pass moves leaves to reduce the
+   * number that are.
+   */
+  struct DefragReport {
+    long visited;    // Leaves visited (including those read to find the
+                     // sub-indices to visit).
+    long moved;      // Leaves moved to another page.
+    long gapsBefore; // Leaves visited that were out of place beforehand,
+    long gapsAfter;  // and afterwards.
+    bool done;       // Whether the call completed a pass over every leaf.
+  };
+}
+
+#endif // DB_DEFRAG_REPORT_H
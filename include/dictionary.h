@@ -0,0 +1,114 @@
+#ifndef DB_DICTIONARY_H
+#define DB_DICTIONARY_H
+
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dim.h"
+#include "key.h"
+
+namespace DB {
+  /**
+   * Dictionary
+   *
+   * Encodes strings as keys, so that string-valued columns may be loaded into
+   * tables, which only hold integers. Each distinct string is given the next
+   * unused code, starting from 0, so codes are dense, and sub-indices over
+   * them are likely to be held in containers. One dictionary should be shared
+   * by every table that is loaded through it, so that equal strings have equal
+   * codes, and can be joined on.
+   *
+   * The dictionary is kept in a file of its own, with one string per line, in
+   * order of their codes. Strings are appended to it as they are first
+   * encoded, and it is read back when the dictionary is next constructed, so
+   * codes stay the same across runs.
+   */
+  struct Dictionary {
+
+    /**
+     * Dictionary::Dictionary
+     *
+     * Open a dictionary, reading back any strings already in its file.
+     *
+     * @param fname The name of the dictionary's file, which is created if it
+     *              does not exist.
+     */
+    Dictionary(const char *fname = Dim::DICT_NAME);
+
+    /** Deleted copy constructors */
+    Dictionary(const Dictionary &) = delete;
+    Dictionary & operator = (const Dictionary &) = delete;
+
+    /**
+     * Dictionary::encode
+     *
+     * @param str A string.
+     * @return The code for the string, which is assigned (and saved) if the
+     *         string has not been seen before.
+     */
+    Key encode(const std::string &str);
+
+    /**
+     * Dictionary::encodeFields
+     *
+     * Encode every field of a line of CSV, ignoring whitespace either side of
+     * each field. Nothing is encoded unless the line has the expected number
+     * of fields.
+     *
+     * @param line  The line, without its line break.
+     * @param width The number of fields the line should have.
+     * @param &out  Buffer that is filled with the code for each field, in
+     *              order.
+     * @return True iff the line has `width` fields, and they were encoded.
+     */
+    bool encodeFields(const std::string &line, int width,
+                      std::vector<Key> &out);
+
+    /**
+     * Dictionary::lookup
+     *
+     * @param str   A string.
+     * @param &code Set to the string's code, if it has one.
+     * @return True iff the string has been encoded.
+     */
+    bool lookup(const std::string &str, Key &code) const;
+
+    /**
+     * Dictionary::decode
+     *
+     * @param code A code assigned by this dictionary.
+     * @return The string with the given code.
+     */
+    const std::string &decode(Key code) const;
+
+    /**
+     * Dictionary::write
+     *
+     * Print a record of codes as a line of CSV, with each column decoded (but
+     * without a line break).
+     *
+     * @param &out  The stream to print to.
+     * @param rec   A buffer holding the record's columns, in order.
+     * @param width The number of columns in the record.
+     */
+    void write(std::ostream &out, const Key *rec, int width) const;
+
+    /**
+     * Dictionary::size
+     *
+     * @return The number of strings in the dictionary (and so the first code
+     *         not yet assigned).
+     */
+    int size() const;
+
+  private:
+    std::unordered_map<std::string, Key> mCodes;
+    std::vector<std::string>             mStrings; // Indexed by code.
+    std::ofstream                        mFile;
+  };
+}
+
+#endif // DB_DICTIONARY_H
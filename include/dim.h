@@ -8,11 +8,38 @@ namespace DB {
    * A centralised location for global constants used throughout the database.
    */
   namespace Dim {
-    constexpr const char *NAME = "inc.db";
+    constexpr const char *NAME      = "inc.db";
+    constexpr const char *DICT_NAME = "inc.db.dict";
 
     constexpr unsigned PAGE_SIZE = 8 << 10;
     constexpr unsigned NUM_PAGES = 300000;
     constexpr unsigned POOL_SIZE = 1000;
+
+    constexpr int INLINE_SIZE     = 3;
+    constexpr int DELTA_SIZE      = 1024;
+    constexpr int ROOT_CACHE_SIZE = 64;
+
+    // Number of records a table reads from a file before inserting them, as a
+    // batch.
+    constexpr int LOAD_BATCH_SIZE = 65536;
+
+    // Number of bytes of a file that each worker parses at a time, when tables
+    // are loaded in parallel.
+    constexpr long INGEST_CHUNK_SIZE = 4 << 20;
+
+    // Number of leaves along from the current one that a seek by an iterator
+    // looks through for its key, before searching from the root instead.
+    constexpr int SEEK_HOPS = 2;
+
+    // Percentage of a full node's slots that it keeps when it is split by an
+    // insertion past the last key in its tree, for the top level of tables
+    // (and views), and for their sub-indices.
+    constexpr int APPEND_FILL     = 90;
+    constexpr int SUB_APPEND_FILL = 100;
+
+    // Percentage of its slots a node may fall to through deletions before it
+    // is merged with, or takes slots from, a sibling.
+    constexpr int MERGE_FILL = 25;
   }
 }
 
@@ -16,9 +16,11 @@ namespace DB {
     Frame();
     ~Frame();
 
-    void pin();
-    void unpin();
+    void pin(bool reader = false);
+    void unpin(bool reader = false);
     bool isPinned() const;
+    bool isReaderPinned() const;
+    bool isPinnedByReadersOnly() const;
 
     void    setPage(page_id pid, bool isEmpty = false);
     page_id getPageID() const;
@@ -36,6 +38,7 @@ namespace DB {
 
     page_id mPID;
     int     mPinCount;
+    int     mReaderPins; // Of mPinCount, the pins held by snapshot readers.
     bool    mDirty;
 
     char    mData[Dim::PAGE_SIZE];
@@ -2,6 +2,7 @@
 #define DB_FTRIE_H
 
 #include "allocator.h"
+#include "key.h"
 #include "trie.h"
 
 #include <memory>
@@ -48,11 +49,11 @@ namespace DB {
      */
     struct Transaction {
       TxnType message;
-      int data[1];
+      Key data[1];
     };
 
     /** Convenient type alias to avoid a long type signature. */
-    using NewSlots = std::vector<int> *;
+    using NewSlots = std::vector<Key> *;
 
     /**
      * FTree::Diff
@@ -93,7 +94,7 @@ namespace DB {
      *         multiple layers of branches.
      */
     static page_id branch(int width, page_id leftPID,
-                          std::vector<int> slots);
+                          std::vector<Key> slots);
 
     /**
      * FTree::load
@@ -123,7 +124,7 @@ namespace DB {
      *         because of the flush. Parent nodes may use this information to
      *         adjust their partitioning keys.
      */
-    static Diff flush(page_id nid, Family family, int *txns);
+    static Diff flush(page_id nid, Family family, Key *txns);
 
     /**
      * FTree::debugPrint
@@ -144,7 +145,7 @@ namespace DB {
      * @param txnSize Size (in number of integers) per transaction.
      * @param width Size (in number of integers) of data segment of transaction.
      */
-    static void debugPrintTxns(int *txns, int txnSize, int width);
+    static void debugPrintTxns(Key *txns, int txnSize, int width);
 
     /**
      * FTree::debugPrintKey
@@ -154,7 +155,7 @@ namespace DB {
      * @param key Pointer to the key.
      * @param width Length of the key.
      */
-    static void debugPrintKey(int *key, int width);
+    static void debugPrintKey(Key *key, int width);
 
     /**
      * FTree::split
@@ -162,12 +163,14 @@ namespace DB {
      * Share the contents of this node between itself and a new neighbour to the
      * right.
      *
-     * @param pid The page ID of this node.
-     * @param key Pointer that is filled with the key that partitions the old
-     *            and new nodes.
+     * @param pid  The page ID of this node.
+     * @param key  Pointer that is filled with the key that partitions the old
+     *             and new nodes.
+     * @param fill The percentage of slots this node keeps (it always keeps
+     *             atleast half).
      * @return The page_id of the new neighbour.
      */
-    page_id split(page_id pid, int *key);
+    page_id split(page_id pid, Key *key, int fill = 50);
 
     /**
      * FTree::merge
@@ -182,7 +185,7 @@ namespace DB {
      * @param part Pointer to the key that partitions these two nodes (When
      *             merging branches, this needs to be added back in).
      */
-    void merge(page_id nid, FTree *that, int *part);
+    void merge(page_id nid, FTree *that, Key *part);
 
     /**
      * FTree::isEmpty
@@ -218,7 +221,7 @@ namespace DB {
      * @param index The index of the slot
      * @return a pointer to the slot.
      */
-    int *slot(int index);
+    Key *slot(int index);
 
     /**
      * FTree::txns
@@ -226,7 +229,7 @@ namespace DB {
      * @param index The index of the slot
      * @return a pointer to the transaction buffer corresponding to the slot.
      */
-    int *txns(int index);
+    Key *txns(int index);
 
     /**
      * (private) FTree::txnSize
@@ -255,7 +258,7 @@ namespace DB {
     int      count;
     int      width;
     page_id  prev, next;
-    int      data[1];
+    Key      data[1];
 
     /**
      * (private) FTree::cmpKey
@@ -267,7 +270,7 @@ namespace DB {
      * @param width Number of columns in a key.
      * @return -1 if key1 < key, 0 if key1 = key2 and +1 if key1 > key2
      */
-    static int cmpKey(int *key1, int *key2, int width);
+    static int cmpKey(Key *key1, Key *key2, int width);
 
     /**
      * (private) FTree::findKey
@@ -278,7 +281,7 @@ namespace DB {
      * @return The index of the slot in the node corresponding to the smallest
      *         key greater than or equal to the one provided.
      */
-    int findKey(int *key, int from = 0);
+    int findKey(Key *key, int from = 0);
 
     /**
      * (private) FTree::findNewSlot
@@ -290,7 +293,7 @@ namespace DB {
      * @param key The key to search for.
      * @return The index into the slots vector where the search ended.
      */
-    int findNewSlot(const NewSlots &slots, int *key);
+    int findNewSlot(const NewSlots &slots, Key *key);
 
     /**
      * (private) FTree::findTxn
@@ -305,7 +308,7 @@ namespace DB {
      * @param key Pointer to the search key.
      * @return The index into the transaction buffer where the search ended.
      */
-    static int findTxn(int *txns, int width, int from, int *key);
+    static int findTxn(Key *txns, int width, int from, Key *key);
 
     /**
      * (private) FTree::mergeTxns
@@ -326,7 +329,7 @@ namespace DB {
      * @return A pointer to a new buffer containing the merge result, (and its
      *         size at position 0).
      */
-    static int *mergeTxns(int *existing, int *incoming, int incCount,
+    static Key *mergeTxns(Key *existing, Key *incoming, int incCount,
                           int width);
 
     /**
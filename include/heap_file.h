@@ -5,6 +5,7 @@
 
 #include "allocator.h"
 #include "dim.h"
+#include "key.h"
 
 namespace DB {
   /**
@@ -35,9 +36,9 @@ namespace DB {
      * Add data to the end of the HeapFile.
      *
      * @param data Buffer to take data from;
-     * @param len  Number of integers to copy.
+     * @param len  Number of keys to copy.
      */
-    void append(int *data, int len);
+    void append(Key *data, int len);
 
     /**
      * HeapFile::clear
@@ -56,12 +57,12 @@ namespace DB {
     struct HeapPage {
       int count;
       page_id next;
-      int data[1];
+      Key data[1];
     };
 
-    // How many integers can we fit in the data section of this page?
+    // How many keys can we fit in the data section of this page?
     static constexpr int PAGE_CAP =
-      (Dim::PAGE_SIZE - offsetof(HeapPage, data)) / sizeof(int);
+      (Dim::PAGE_SIZE - offsetof(HeapPage, data)) / sizeof(Key);
 
     HeapPage * mLastPage;
     page_id    mFirstPID;
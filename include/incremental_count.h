@@ -23,7 +23,10 @@ namespace DB {
     void recompute() override;
 
   protected:
-    void updateView(int table, Op op, int x, int y, bool didChange) override;
+    void updateView(int table, Op op, const Key *rec,
+                    bool didChange) override;
+
+    bool purgeView(int table, Key lo, Key hi) override;
 
   private:
     int mCount;
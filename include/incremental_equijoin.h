@@ -11,7 +11,7 @@ namespace DB {
      *
      * Constructor.
      */
-    IncrementalEquiJoin(int width, Tables tables);
+    IncrementalEquiJoin(int width, Tables tables, Bindings bindings = {});
 
     /**
      * IncrementalEquiJoin::IncrementalEquiJoin
@@ -24,7 +24,10 @@ namespace DB {
     void recompute() override;
 
   protected:
-    void updateView(int table, Op op, int x, int y, bool didChange) override;
+    void updateView(int table, Op op, const Key *rec,
+                    bool didChange) override;
+
+    bool purgeView(int table, Key lo, Key hi) override;
 
   private:
     View mJoin;
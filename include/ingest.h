@@ -0,0 +1,109 @@
+#ifndef DB_INGEST_H
+#define DB_INGEST_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "key.h"
+#include "table.h"
+
+namespace DB {
+  /**
+   * Ingest
+   *
+   * Loads several tables from CSV files at once. Files are split into chunks of
+   * `INGEST_CHUNK_SIZE` bytes (at line breaks), which a pool of worker threads
+   * parse in parallel. Each table is then filled with all the records parsed
+   * for it in a single sorted batch (see `Table::insertBatch`), with different
+   * tables being filled by different workers at the same time.
+   *
+   * Files are in the same format as for `Table::loadFromFile`, with integer
+   * columns (strings must be loaded through a dictionary, one table at a time).
+   * As there, loading a file stops at its first line that is not a record of
+   * the table.
+   */
+  struct Ingest {
+
+    /**
+     * Ingest::Ingest
+     *
+     * @param threads The number of worker threads to use, or 0 to use one per
+     *                core.
+     */
+    Ingest(int threads = 0);
+
+    /**
+     * Ingest::add
+     *
+     * Queue a file to be loaded into a table. A table may be given more than
+     * one file, in which case their records are inserted in one batch.
+     *
+     * @param table The table to load into.
+     * @param fname The name of the file to load from.
+     */
+    void add(std::shared_ptr<Table> table, const char *fname);
+
+    /**
+     * Ingest::run
+     *
+     * Load every queued file into its table, and empty the queue.
+     *
+     * @return The number of records added across all the tables.
+     */
+    long run();
+
+  private:
+    struct Source {
+      std::shared_ptr<Table> table;
+      std::string            fname;
+    };
+
+    struct Chunk {
+      int              source;
+      long             from, to; // Byte range of the lines it owns.
+      std::vector<Key> recs;
+      bool             ok;       // False if it hit a line it could not parse.
+    };
+
+    int                 mThreads;
+    std::vector<Source> mSources;
+
+    /**
+     * (private) Ingest::parallel
+     *
+     * Run a task for each index in [0, n), spread across the worker threads.
+     *
+     * @param n    The number of tasks.
+     * @param task Called with the index of each task, on any thread.
+     */
+    template <typename Task>
+    void parallel(int n, Task task);
+
+    /**
+     * (private) Ingest::parse
+     *
+     * Parse the records from the lines of a file that start within a chunk.
+     *
+     * @param fname  The name of the file.
+     * @param width  The number of columns in each record.
+     * @param &chunk The chunk, whose records are appended to.
+     */
+    static void parse(const std::string &fname, int width, Chunk &chunk);
+
+    /**
+     * (private) Ingest::parseLine
+     *
+     * @param p     The start of the line.
+     * @param end   The end of the line (excluding its line break).
+     * @param width The number of columns in each record.
+     * @param &out  Buffer that the line's record is appended to.
+     * @return False iff the line is not blank, and not a record either (which
+     *         includes a record with a column out of the range of keys).
+     */
+    static bool parseLine(const char *p, const char *end, int width,
+                          std::vector<Key> &out);
+  };
+}
+
+#endif // DB_INGEST_H
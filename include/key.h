@@ -0,0 +1,21 @@
+#ifndef DB_KEY_H
+#define DB_KEY_H
+
+#include <cstdint>
+
+namespace DB {
+  /**
+   * Key
+   *
+   * Type alias for keys: the values in the columns of the records held in
+   * tables, indices and views. Keys are 32-bit integers by default, and 64-bit
+   * integers when compiled with `KEY64` defined.
+   */
+#ifdef KEY64
+  using Key = int64_t;
+#else
+  using Key = int32_t;
+#endif
+}
+
+#endif // DB_KEY_H
@@ -1,6 +1,7 @@
 #ifndef DB_LEAPFROG_TRIEJOIN_H
 #define DB_LEAPFROG_TRIEJOIN_H
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -40,9 +41,9 @@ namespace DB {
     void open()               override;
     void up()                 override;
     void next()               override;
-    void seek(int searchKey)  override;
+    void seek(Key searchKey)  override;
 
-    int  key()          const override;
+    Key  key()          const override;
     bool atEnd()        const override;
     bool atValidDepth() const override;
 
@@ -51,12 +52,19 @@ namespace DB {
 
     int  mDepth;
     int  mNextIter;
-    int  mKey;
+    Key  mKey;
     bool mAtEnd;
 
     std::vector<TrieIterator::Ptr> mActiveIters;
     std::vector<TrieIterator::Ptr> mDormantIters;
 
+    // When every active iterator holds its keys at the last depth in a bitmap,
+    // the keys in all of them, found a word at a time, starting from key
+    // `mBitsBase`.
+    bool                  mUseBits;
+    Key                   mBitsBase;
+    std::vector<uint64_t> mBits;
+
     /**
      * (private) LeapFrogTrieJoin::init();
      *
@@ -72,6 +80,27 @@ namespace DB {
      * them is expended.
      */
     void search();
+
+    /**
+     * (private) LeapFrogTrieJoin::intersectBits();
+     *
+     * At the last depth of the join, if every active iterator exposes a
+     * bitmap, intersect them word by word, and position the join at the first
+     * key in the result, instead of searching.
+     *
+     * @return True iff the bitmaps were intersected.
+     */
+    bool intersectBits();
+
+    /**
+     * (private) LeapFrogTrieJoin::seekBits();
+     *
+     * Move to the first key in the intersected bitmaps greater than or equal
+     * to the given key, or to the end.
+     *
+     * @param key The search key.
+     */
+    void seekBits(Key key);
   };
 }
 
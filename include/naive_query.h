@@ -7,16 +7,21 @@ namespace DB {
   /**
    * NaiveQuery
    *
-   * Thin wrapper around Query that defines `updateView` in terms of
-   * `recompute`.
+   * Thin wrapper around Query that defines `updateView` and `purgeView` in
+   * terms of `recompute`.
    */
   struct NaiveQuery : public Query {
     using Query::Query;
 
-    void updateView(int, Op, int, int, bool) override
+    void updateView(int, Op, const Key *, bool) override
     {
       recompute();
     }
+
+    bool purgeView(int, Key, Key) override
+    {
+      return true;
+    }
   };
 }
 
@@ -0,0 +1,109 @@
+#ifndef DB_PAGE_VERSIONS_H
+#define DB_PAGE_VERSIONS_H
+
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "allocator.h"
+
+namespace DB {
+  /**
+   * PageVersions
+   *
+   * Keeps old versions of the pages of an index, so that readers can keep a
+   * consistent view of it while a writer goes on changing it in place.
+   *
+   * Each reader is given an epoch when it starts. Before the writer changes a
+   * page, it asks for the page to be preserved. The current contents are then
+   * copied to a fresh page, tagged with the newest reader's epoch, unless a
+   * copy for that epoch already exists. A reader at epoch `e` sees the
+   * earliest copy tagged at or after `e`, or the page itself if there is none.
+   * Copies are freed once every reader at or before their epoch has finished.
+   *
+   * Readers may enter, leave and resolve pages on other threads than the
+   * writer's.
+   */
+  struct PageVersions {
+
+    /**
+     * PageVersions::PageVersions
+     *
+     * Construct a store without any readers or old versions.
+     */
+    PageVersions();
+
+    /**
+     * PageVersions::~PageVersions
+     *
+     * Frees any remaining old versions.
+     */
+    ~PageVersions();
+
+    /** Deleted copy constructors */
+    PageVersions(const PageVersions &) = delete;
+    PageVersions & operator = (const PageVersions &) = delete;
+
+    /**
+     * PageVersions::enter
+     *
+     * Register a new reader, which sees pages as they are now.
+     *
+     * @return The reader's epoch.
+     */
+    int enter();
+
+    /**
+     * PageVersions::leave
+     *
+     * Unregister a reader, and free any old versions that no remaining reader
+     * can see.
+     *
+     * @param epoch The epoch of the reader, as returned by `enter`.
+     */
+    void leave(int epoch);
+
+    /**
+     * PageVersions::preserve
+     *
+     * Called before a page is changed. Copies the page if any current reader
+     * might still need to see its current contents.
+     *
+     * @param pid The page ID of the page about to be changed.
+     * @return True iff a copy was made.
+     */
+    bool preserve(page_id pid);
+
+    /**
+     * PageVersions::resolve
+     *
+     * @param pid   The ID of a page, as referenced from within the index.
+     * @param epoch The epoch of a reader.
+     * @return The ID of the page holding the version of `pid` that the reader
+     *         should see.
+     */
+    page_id resolve(page_id pid, int epoch) const;
+
+  private:
+    using Chain = std::vector<std::pair<int, page_id>>;
+
+    mutable std::mutex                   mLatch;
+    int                                  mEpoch;    // Latest epoch handed out.
+    std::multiset<int>                   mReaders;  // Epochs of live readers.
+    std::unordered_map<page_id, Chain>   mVersions; // Copies of each page, in
+                                                    // ascending order of epoch.
+
+    /**
+     * (private) PageVersions::reclaim
+     *
+     * Free the copies tagged with epochs before the given one.
+     *
+     * @param epoch The earliest epoch to keep copies for.
+     */
+    void reclaim(int epoch);
+  };
+}
+
+#endif // DB_PAGE_VERSIONS_H
@@ -1,10 +1,13 @@
 #ifndef DB_QUERY_H
 #define DB_QUERY_H
 
+#include <functional>
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 #include "table.h"
+#include "trie_iterator.h"
 
 namespace DB {
   /**
@@ -22,6 +25,16 @@ namespace DB {
      */
     using Tables = std::unordered_map<int, std::shared_ptr<Table>>;
 
+    /**
+     * Query::Bindings
+     *
+     * Alias for a map from relation names to the position in the global
+     * ordering of each column of the table with that name. Tables without a
+     * binding are read with their columns at the positions they were
+     * constructed with.
+     */
+    using Bindings = std::unordered_map<int, std::vector<int>>;
+
     /**
      * Query::Op
      *
@@ -37,9 +50,14 @@ namespace DB {
      *
      * @param width  Size of a record in the join (The number of unique
      *               parameters in the query).
-     * @param tables The list of tables to keep track of.
+     * @param tables The list of tables to keep track of. The same table may be
+     *               given under several names (for self-joins), in which case
+     *               it is updated once, but read once under each name.
+     * @param bindings The positions to read some of the tables' columns at,
+     *                 if not their own. The tables are asked to keep an
+     *                 ordering for each binding, if they need one.
      */
-    Query(int width, Tables tables);
+    Query(int width, Tables tables, Bindings bindings = {});
 
     /**
      * Query::~Query
@@ -58,11 +76,51 @@ namespace DB {
      *              and refers to the order in which tables were given to the
      *              query when it was constructed.
      * @param op   The operation to perform.
+     * @param rec  A buffer holding the record, which is assumed to be atleast
+     *             as wide as the table.
+     * @return The time in nanoseconds required to update the view.
+     */
+    long update(int table, Op op, const Key *rec);
+
+    /**
+     * Query::update
+     *
+     * Perform an update on the given table (with two columns), and update the
+     * result of the query to reflect this change.
+     *
+     * @param table The index of the table to update.
+     * @param op   The operation to perform.
      * @param x    The value of the first column of the record.
      * @param y    The value of the second column of the record.
      * @return The time in nanoseconds required to update the view.
      */
-    long update(int table, Op op, int x, int y);
+    long update(int table, Op op, Key x, Key y);
+
+    /**
+     * Query::removeAll
+     *
+     * Remove every record from the given table whose first column is `x`, and
+     * update the result of the query to reflect this change.
+     *
+     * @param table The index of the table to update.
+     * @param x     The value of the first column of the records to remove.
+     * @return The time in nanoseconds required to update the view.
+     */
+    long removeAll(int table, Key x);
+
+    /**
+     * Query::removeRange
+     *
+     * Remove every record from the given table whose first column falls in the
+     * range [lo, hi], and update the result of the query to reflect this
+     * change.
+     *
+     * @param table The index of the table to update.
+     * @param lo    The smallest first column value to remove (inclusive).
+     * @param hi    The largest first column value to remove (inclusive).
+     * @return The time in nanoseconds required to update the view.
+     */
+    long removeRange(int table, Key lo, Key hi);
 
     /**
      * Query::recompute
@@ -71,6 +129,13 @@ namespace DB {
      */
     virtual void recompute() = 0;
 
+    /**
+     * Query::getTables
+     *
+     * @return A (const) reference to the sequence of tables
+     */
+    const Tables &getTables() const;
+
   protected:
     /**
      * (protected) Query::updateView
@@ -80,18 +145,93 @@ namespace DB {
      *
      * @param table The name of the table to update.
      * @param op The operation to perform.
-     * @param x The value of the first column of the record.
-     * @param y The value of the second column of the record.
+     * @param rec A buffer holding the record.
      * @param didChange True iff the input table changed.
      */
-    virtual void updateView(int table, Op op, int x, int y, bool didChange) = 0;
+    virtual void updateView(int table, Op op, const Key *rec,
+                            bool didChange) = 0;
 
     /**
-     * (protected) Query::getTables
+     * (protected) Query::purgeView
      *
-     * @return A (const) reference to the sequence of tables
+     * Update the view to reflect the removal of a slice of an input table.
+     * This is called whilst the records are still in the table, so that they
+     * may be joined against. Concrete sub-classes must implement this.
+     *
+     * @param table The name of the table being updated.
+     * @param lo    The smallest first column value being removed.
+     * @param hi    The largest first column value being removed.
+     * @return True iff the view must instead be recomputed once the records
+     *         have been removed.
      */
-    const Tables &getTables() const;
+    virtual bool purgeView(int table, Key lo, Key hi) = 0;
+
+    /**
+     * (protected) Query::Delta
+     *
+     * Alias for a function producing an iterator over the records being
+     * changed, read as the table with the given name.
+     */
+    using Delta = std::function<TrieIterator::Ptr(int table)>;
+
+    /**
+     * (protected) Query::Visit
+     *
+     * Alias for a function given each join that the change to a table
+     * contributes to the view, and the sign of its contribution.
+     */
+    using Visit = std::function<void(TrieIterator::Ptr &query, int sign)>;
+
+    /**
+     * (protected) Query::joinDelta
+     *
+     * Join a change to a table against the other tables in the query. When the
+     * table is read under one name, this is a single join, with the change in
+     * place of the table. Otherwise, it is read under each of its names in
+     * turn: every non-empty set of them reads the change, and the rest read the
+     * whole table, so that every record of the join reading the change under
+     * at least one name is found.
+     *
+     * @param table   The name of the table being changed.
+     * @param present True iff the table currently holds the records being
+     *                changed. If so, the joins overlap, and their signs
+     *                alternate (by inclusion-exclusion) so that their counts
+     *                sum to the size of the change to the view. Otherwise, they
+     *                are disjoint, and all positive.
+     * @param delta   Produces the change, read under a given name.
+     * @param visit   Called with each join, and its sign.
+     */
+    void joinDelta(int table, bool present,
+                   const Delta &delta, const Visit &visit) const;
+
+    /**
+     * (protected) Query::scan
+     *
+     * @param table The name of a table.
+     * @return An iterator over the whole table, read under the given name.
+     */
+    TrieIterator::Ptr scan(int table) const;
+
+    /**
+     * (protected) Query::slice
+     *
+     * @param table The name of a table.
+     * @param lo    The smallest first column value to include (inclusive).
+     * @param hi    The largest first column value to include (inclusive).
+     * @return An iterator over the records of the table whose first column
+     *         falls in the range [lo, hi], read under the given name.
+     */
+    TrieIterator::Ptr slice(int table, Key lo, Key hi) const;
+
+    /**
+     * (protected) Query::singleton
+     *
+     * @param table The name of a table.
+     * @param rec   A buffer holding the record's columns, in order.
+     * @return An iterator over just the given record, read under the given
+     *         name.
+     */
+    TrieIterator::Ptr singleton(int table, const Key *rec) const;
 
     /**
      * (protected) Query::getWidth()
@@ -101,8 +241,9 @@ namespace DB {
     int getWidth() const;
 
   private:
-    int    mWidth;
-    Tables mTables;
+    int      mWidth;
+    Tables   mTables;
+    Bindings mBindings;
   };
 }
 
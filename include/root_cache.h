@@ -0,0 +1,110 @@
+#ifndef DB_ROOT_CACHE_H
+#define DB_ROOT_CACHE_H
+
+#include <vector>
+
+#include "allocator.h"
+#include "key.h"
+
+namespace DB {
+  /**
+   * RootCache
+   *
+   * A bounded, direct-mapped cache from keys in the top level of a table to
+   * the page IDs of the roots of their sub-indices, so that updates to hot
+   * keys may skip the descent through the top level. Each key may only be
+   * cached in one slot, and a new key evicts whichever key held its slot
+   * before.
+   *
+   * The cache does not watch the table: whoever moves or frees a sub-index's
+   * root must update or erase its entry.
+   */
+  struct RootCache {
+
+    /**
+     * RootCache::RootCache
+     *
+     * An empty cache.
+     *
+     * @param size The number of slots in the cache. Must be a power of two.
+     */
+    RootCache(int size);
+
+    /**
+     * RootCache::lookup
+     *
+     * @param key  The key in the top level of the table.
+     * @param &pid Set to the root of the key's sub-index, if it is cached.
+     * @return True iff the key is cached. Counts towards the hit rate.
+     */
+    bool lookup(Key key, page_id &pid);
+
+    /**
+     * RootCache::put
+     *
+     * Cache the root of a key's sub-index, evicting the key in its slot.
+     *
+     * @param key The key in the top level of the table.
+     * @param pid The page ID of the root of its sub-index.
+     */
+    void put(Key key, page_id pid);
+
+    /**
+     * RootCache::erase
+     *
+     * Forget the given key, if it is cached.
+     *
+     * @param key The key in the top level of the table.
+     */
+    void erase(Key key);
+
+    /**
+     * RootCache::clear
+     *
+     * Forget every key. The hit rate statistics are kept.
+     */
+    void clear();
+
+    /**
+     * RootCache::getHits
+     *
+     * @return The number of lookups that found their key.
+     */
+    long getHits() const;
+
+    /**
+     * RootCache::getMisses
+     *
+     * @return The number of lookups that did not find their key.
+     */
+    long getMisses() const;
+
+    /**
+     * RootCache::getHitRate
+     *
+     * @return The fraction of lookups that found their key, or 0 if there
+     *         have been none.
+     */
+    double getHitRate() const;
+
+  private:
+    struct Entry {
+      Key     key;
+      page_id pid; // `INVALID_PAGE` if the slot is empty.
+    };
+
+    std::vector<Entry> mEntries;
+    long               mHits;
+    long               mMisses;
+
+    /**
+     * (private) RootCache::slot
+     *
+     * @param key The key in the top level of the table.
+     * @return The only slot the key may be cached in.
+     */
+    Entry &slot(Key key);
+  };
+}
+
+#endif // DB_ROOT_CACHE_H
@@ -1,6 +1,8 @@
 #ifndef DB_SINGLETON_ITERATOR_H
 #define DB_SINGLETON_ITERATOR_H
 
+#include <vector>
+
 #include "trie_iterator.h"
 
 namespace DB {
@@ -9,15 +11,13 @@ namespace DB {
     /**
      * SingletonIterator::SingletonIterator
      *
-     * Construct a trie iterator which contains only the record
-     * [x, y].
+     * Construct a trie iterator which contains only one record.
      *
-     * @param fst The position of the first column.
-     * @param x   The value of the record at the first column.
-     * @param snd The position of the second column.
-     * @param y   The value of the record at the second column.
+     * @param order The position of each column of the record in the global
+     *              ordering, in ascending order.
+     * @param rec   The value of the record at each of those columns.
      */
-    SingletonIterator(int fst, int x, int snd, int y);
+    SingletonIterator(std::vector<int> order, std::vector<Key> rec);
 
     /** Deleted Copy Constructors */
     SingletonIterator(const SingletonIterator &) = delete;
@@ -28,22 +28,26 @@ namespace DB {
     void open()               override;
     void up()                 override;
     void next()               override;
-    void seek(int searchKey)  override;
+    void seek(Key searchKey)  override;
 
-    int  key()          const override;
+    Key  key()          const override;
     bool atEnd()        const override;
     bool atValidDepth() const override;
 
   private:
-    const int mFst;
-    const int mX;
-    const int mSnd;
-    const int mY;
+    const std::vector<int> mOrder;
+    const std::vector<Key> mRec;
 
     int mDepth;
-    bool mFstAtEnd;
-    bool mSndAtEnd;
+    std::vector<bool> mAtEnd;
 
+    /**
+     * (private) SingletonIterator::level
+     *
+     * @return The index of the column at the current depth, or -1 if there is
+     *         no such column.
+     */
+    int level() const;
   };
 }
 
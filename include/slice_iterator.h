@@ -0,0 +1,53 @@
+#ifndef DB_SLICE_ITERATOR_H
+#define DB_SLICE_ITERATOR_H
+
+#include "trie_iterator.h"
+
+namespace DB {
+  /**
+   * SliceIterator
+   *
+   * Wraps a trie iterator, hiding all the keys at one of its depths that fall
+   * outside of a given range.
+   */
+  struct SliceIterator : public TrieIterator {
+
+    /**
+     * SliceIterator::SliceIterator
+     *
+     * @param it    The iterator to wrap (starting at depth -1).
+     * @param depth The depth at which to restrict keys.
+     * @param lo    The smallest key to keep at that depth (inclusive).
+     * @param hi    The largest key to keep at that depth (inclusive).
+     */
+    SliceIterator(TrieIterator::Ptr it, int depth, Key lo, Key hi);
+
+    /** Deleted Copy Constructors */
+    SliceIterator(const SliceIterator &) = delete;
+    SliceIterator & operator = (const SliceIterator &) = delete;
+
+    /** TrieIterator method overrides */
+
+    void open()               override;
+    void up()                 override;
+    void next()               override;
+    void seek(Key searchKey)  override;
+
+    Key  key()          const override;
+    bool atEnd()        const override;
+    bool atValidDepth() const override;
+
+    bool bits(Bits &out) const override;
+
+  private:
+    TrieIterator::Ptr mIt;
+
+    const int mSliceDepth;
+    const Key mLo;
+    const Key mHi;
+
+    int mDepth;
+  };
+}
+
+#endif // DB_SLICE_ITERATOR_H
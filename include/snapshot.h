@@ -0,0 +1,75 @@
+#ifndef DB_SNAPSHOT_H
+#define DB_SNAPSHOT_H
+
+#include <memory>
+#include <vector>
+
+#include "allocator.h"
+#include "page_versions.h"
+#include "trie_iterator.h"
+
+namespace DB {
+  /**
+   * Snapshot
+   *
+   * A frozen view of a table's contents at the moment it was taken. Updates
+   * made to the table afterwards are not visible through the snapshot, and do
+   * not disturb iterators reading from it. The old page versions the snapshot
+   * relies on are kept until it, and every iterator created from it, has been
+   * destroyed.
+   */
+  struct Snapshot : public std::enable_shared_from_this<Snapshot> {
+
+    /**
+     * Snapshot::Snapshot
+     *
+     * Take a snapshot of an index. Use `Table::snapshot` rather than calling
+     * this directly.
+     *
+     * @param versions The store of old versions of the index's pages.
+     * @param rootPID  The page ID of the root of the index.
+     * @param order    The position in the global ordering of each level of the
+     *                 index, in ascending order.
+     */
+    Snapshot(std::shared_ptr<PageVersions> versions,
+             page_id rootPID,
+             std::vector<int> order);
+
+    /**
+     * Snapshot::~Snapshot
+     *
+     * Releases the snapshot's hold on old versions of pages.
+     */
+    ~Snapshot();
+
+    /** Deleted copy constructors */
+    Snapshot(const Snapshot &) = delete;
+    Snapshot & operator = (const Snapshot &) = delete;
+
+    /**
+     * Snapshot::scan
+     *
+     * @return A pointer to an iterator that traverses the contents of the
+     *         table at the time the snapshot was taken, regardless of any
+     *         modifications made to it since. The iterator keeps the snapshot
+     *         alive.
+     */
+    TrieIterator::Ptr scan();
+
+    /**
+     * Snapshot::resolve
+     *
+     * @param pid The ID of a page, as referenced from within the index.
+     * @return The ID of the page holding its contents as of the snapshot.
+     */
+    page_id resolve(page_id pid) const;
+
+  private:
+    std::shared_ptr<PageVersions> mVersions;
+    page_id                       mRootPID;
+    std::vector<int>              mOrder;
+    int                           mEpoch;
+  };
+}
+
+#endif // DB_SNAPSHOT_H
@@ -4,68 +4,242 @@
 #include <cstddef>
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "allocator.h"
+#include "btrie.h"
+#include "csr_trie.h"
+#include "defrag_report.h"
+#include "dictionary.h"
 #include "dim.h"
+#include "page_versions.h"
+#include "root_cache.h"
+#include "snapshot.h"
+#include "table_stats.h"
 #include "trie_iterator.h"
 
 namespace DB {
   /**
    * Table
    *
-   * Representation of input tables, stored in a Nested B+ Trie. It is assumed
-   * that all input tables have 2 integer columns, and do not permit duplicates.
+   * Representation of input tables, stored in a Nested B+ Trie, with one level
+   * of nesting per column. It is assumed that all input tables have integer
+   * columns, and do not permit duplicates. Tables that fit in memory may
+   * instead be stored in a CSRTrie, which avoids the buffer manager entirely.
+   *
+   * Columns are nested in the order they appear in the global ordering. The
+   * sub-indices at the last level start out inline in their slot in the level
+   * above, and are only moved into pages of their own once they hold more than
+   * `Dim::INLINE_SIZE` keys. When such a sub-index outgrows a single leaf, it
+   * is moved into a Container instead, if its keys are dense enough to fit in
+   * one, and moved back out once it thins out again.
+   *
+   * A table may also keep copies of its records nested in other orders, so
+   * that queries needing different global orderings can share it.
+   *
+   * Updates may come from several threads, but they do not run in parallel:
+   * each takes the table's latch for its whole length, so there is only ever
+   * one writer. Other threads may read the table concurrently through
+   * snapshots, which do not wait for the latch beyond the moment they are
+   * taken. Scans of the live table must not overlap with updates.
    */
   struct Table {
 
+    /**
+     * Table::Engine
+     *
+     * Tag for the storage engine holding a table's records.
+     */
+    enum Engine : unsigned char { Paged, Memory };
+
     /**
      * Table::Table
      *
      * Constructs an empty table.
      *
+     * @param order  The position of each of the table's columns in the global
+     *               ordering. No two columns may share a position.
+     * @param engine Where to store the table's records: in a Nested B+ Trie
+     *               in pages managed by the buffer manager, or in a CSRTrie in
+     *               memory.
+     */
+    Table(std::vector<int> order, Engine engine = Paged);
+
+    /**
+     * Table::Table
+     *
+     * Constructs an empty table with two columns.
+     *
      * @param order1 The position of the table's first column in the global
      *               ordering.
      * @param order2 The position of the table's second column in the global
      *               ordering.
+     * @param engine Where to store the table's records.
      */
-    Table(int order1, int order2);
+    Table(int order1, int order2, Engine engine = Paged);
 
     /** Deleted copy constructors */
     Table(const Table &) = delete;
     Table & operator = (const Table &) = delete;
 
+    /**
+     * Table::getWidth
+     *
+     * @return The number of columns in the table.
+     */
+    int getWidth() const;
+
+    /**
+     * Table::getEngine
+     *
+     * @return The storage engine holding the table's records.
+     */
+    Engine getEngine() const;
+
+    /**
+     * Table::getStats
+     *
+     * @return Statistics about the table's current contents, which are kept up
+     *         to date by every update to the table.
+     */
+    const TableStats &getStats() const;
+
+    /**
+     * Table::getCache
+     *
+     * @return The cache of the roots of the table's hot sub-indices, along
+     *         with its hit rate.
+     */
+    const RootCache &getCache() const;
+
+    /**
+     * Table::count
+     *
+     * Count the records in the table whose first column is `x`. When the first
+     * column is the outermost level of a table with at most two columns, this
+     * is read off the total kept at the root of `x`'s sub-index, without
+     * visiting its leaves.
+     *
+     * @param x The value of the first column of the records to count.
+     * @return The number of records whose first column is `x`.
+     */
+    int count(Key x);
+
     /**
      * Table::loadFromFile
      *
      * Insert data into the table from a file. The file should be
      * read-accessible to the database, and the format should be CSV with one
-     * record (two columns) per line.
+     * record (as many columns as the table) per line. Records are inserted
+     * `Dim::LOAD_BATCH_SIZE` at a time, as by `insertBatch`.
      *
      * @param fname The name of the file to load from
+     * @param dict  If given, every column is read as a string, and encoded
+     *              through the dictionary, otherwise columns are integers.
      */
-    void loadFromFile(const char *fname);
+    void loadFromFile(const char *fname, Dictionary *dict = nullptr);
 
     /**
      * Table::insert
      *
      * Insert a record into the table.
      *
+     * @param rec A buffer holding the record's columns, in order. It is assumed
+     *            to be atleast as wide as the table.
+     * @return True iff the insertion changed the table.
+     */
+    bool insert(const Key *rec);
+
+    /**
+     * Table::insert
+     *
+     * Insert a record into a table with two columns.
+     *
      * @param x The value of the record's first column.
      * @param y The value of the record's second column.
      * @return True iff the insertion changed the table.
      */
-    bool insert(int x, int y);
+    bool insert(Key x, Key y);
+
+    /**
+     * Table::insertBatch
+     *
+     * Insert many records at once, as in a bulk load. The records are sorted
+     * into the order the table nests them first, so that each is inserted
+     * beside the last, and the table's pages fill from left to right.
+     *
+     * @param recs The records, one after the other, with each record's columns
+     *             in order.
+     * @return The number of records that were not already in the table.
+     */
+    int insertBatch(const std::vector<Key> &recs);
 
     /**
      * Table::remove
      *
      * Remove a record from the table.
      *
+     * @param rec A buffer holding the record's columns, in order. It is assumed
+     *            to be atleast as wide as the table.
+     * @return True iff the deletion changed the table.
+     */
+    bool remove(const Key *rec);
+
+    /**
+     * Table::remove
+     *
+     * Remove a record from a table with two columns.
+     *
      * @param x The value of the record's first column.
      * @param y The value of the record's second column.
      * @return True iff the deletion changed the table.
      */
-    bool remove(int x, int y);
+    bool remove(Key x, Key y);
+
+    /**
+     * Table::removeAll
+     *
+     * Remove every record from the table whose first column is `x`.
+     *
+     * @param x The value of the first column of the records to remove.
+     * @return True iff the deletion changed the table.
+     */
+    bool removeAll(Key x);
+
+    /**
+     * Table::removeRange
+     *
+     * Remove every record from the table whose first column falls in the range
+     * [lo, hi]. When the first column is also the outermost level of the trie,
+     * the sub-index under each matching key is freed page by page, without
+     * deleting its keys one at a time, and the matching keys are cleared from
+     * each leaf of the top level at once. In memory, the matching records are
+     * cut out of the trie's arrays together.
+     *
+     * @param lo The smallest first column value to remove (inclusive).
+     * @param hi The largest first column value to remove (inclusive).
+     * @return True iff the deletion changed the table.
+     */
+    bool removeRange(Key lo, Key hi);
+
+    /**
+     * Table::defragment
+     *
+     * Continue moving the leaves of the table's trie (and then those of its
+     * other orderings) into ascending page order, so that scans read the
+     * database file sequentially (see `BTrie::defragment`). Each call visits
+     * a bounded number of leaves, and picks up where the last one left off,
+     * starting over once every leaf has been visited. After the top level of
+     * each trie, the pass visits every sub-index with pages of its own (not
+     * those held inline or in a container), in key order, so that each
+     * sub-index's leaves end up contiguous. Tables using the `Memory` engine
+     * have no pages to move.
+     *
+     * @param budget The most leaves to visit.
+     * @return An account of the leaves visited and moved.
+     */
+    DefragReport defragment(int budget);
 
     /**
      * Table::scan
@@ -76,25 +250,364 @@ namespace DB {
      */
     TrieIterator::Ptr scan();
 
+    /**
+     * Table::slice
+     *
+     * @param lo The smallest first column value to include (inclusive).
+     * @param hi The largest first column value to include (inclusive).
+     * @return A pointer to an iterator over just the records of the table whose
+     *         first column falls in the range [lo, hi]. The same caveats apply
+     *         as for `Table::scan`.
+     */
+    TrieIterator::Ptr slice(Key lo, Key hi);
+
+    /**
+     * Table::snapshot
+     *
+     * Take a snapshot of the table's current contents. Iterators created from
+     * the snapshot are unaffected by later modifications to the table, which
+     * preserve the old versions of any pages they change for as long as the
+     * snapshot, or any of its iterators, is alive. The snapshot and its
+     * iterators may be used on other threads than the one updating the table,
+     * while it does so. Only supported by the `Paged` engine.
+     *
+     * @return A pointer to the snapshot.
+     */
+    std::shared_ptr<Snapshot> snapshot();
+
     /**
      * Table::singleton
      *
      * Produce an iterator for a one record slice of the table.
      *
+     * @param rec A buffer holding the record's columns, in order. It is assumed
+     *            to be atleast as wide as the table.
+     * @return An iterator containing just the given record as if it originated
+     *         from an iterator for this table.
+     */
+    TrieIterator::Ptr singleton(const Key *rec);
+
+    /**
+     * Table::singleton
+     *
+     * Produce an iterator for a one record slice of a table with two columns.
+     *
      * @param x The value of the record's first column.
      * @param y The value of the record's second column.
 
      * @return An iterator containing just the record [x, y] as if it originated
      *         from an iterator for this table.
      */
-    TrieIterator::Ptr singleton(int x, int y);
+    TrieIterator::Ptr singleton(Key x, Key y);
+
+    /**
+     * Table::addOrdering
+     *
+     * Keep a secondary copy of the table's records, with its columns nested in
+     * a different order, to serve iterators that ask for that order. Every
+     * later update to the table is applied to all of its orderings together.
+     *
+     * @param order The position of each of the table's columns in a global
+     *              ordering, as for the constructor. Orders that nest the
+     *              columns the same way are served by the same copy, so adding
+     *              one that the table already has does nothing.
+     */
+    void addOrdering(const std::vector<int> &order);
+
+    /**
+     * Table::scan
+     *
+     * @param order The position of each of the table's columns in the global
+     *              ordering of the query the iterator is for. The table must
+     *              have an ordering that nests its columns the same way.
+     * @return A pointer to an iterator over the table, with its columns at the
+     *         given positions. The same caveats apply as for `Table::scan`.
+     */
+    TrieIterator::Ptr scan(const std::vector<int> &order);
+
+    /**
+     * Table::slice
+     *
+     * @param lo    The smallest first column value to include (inclusive).
+     * @param hi    The largest first column value to include (inclusive).
+     * @param order The position of each of the table's columns in the global
+     *              ordering, as for `Table::scan`.
+     * @return A pointer to an iterator over just the records of the table whose
+     *         first column falls in the range [lo, hi], with its columns at the
+     *         given positions.
+     */
+    TrieIterator::Ptr slice(Key lo, Key hi, const std::vector<int> &order);
+
+    /**
+     * Table::singleton
+     *
+     * @param rec   A buffer holding the record's columns, in order.
+     * @param order The position of each of the table's columns in the global
+     *              ordering. Any order may be given, whether the table has an
+     *              ordering for it or not.
+     * @return An iterator containing just the given record, with its columns at
+     *         the given positions.
+     */
+    TrieIterator::Ptr singleton(const Key *rec, const std::vector<int> &order);
 
   private:
 
-    page_id mRootPID;
-    int     mRootOrder;
-    int     mSubOrder;
-    bool    mIsReversed;
+    page_id          mRootPID;
+    int              mWidth;
+    std::vector<int> mOrder;  // Position in the global ordering of each level.
+    std::vector<int> mColumn; // Column of the record held at each level.
+    std::vector<Key> mKeys;   // Record being updated, permuted into levels.
+    TableStats       mStats;
+
+    // Roots of the sub-indices of recently updated keys in the top level.
+    RootCache mCache;
+
+    // Old versions of pages, kept for snapshots.
+    std::shared_ptr<PageVersions> mVersions;
+
+    // Records of tables using the `Memory` engine (null otherwise).
+    std::unique_ptr<CSRTrie> mMemory;
+
+    // Copies of the table's records, nested in other orders.
+    std::vector<std::unique_ptr<Table>> mOrderings;
+
+    // What the current pass of `defragment` does next with the sub-index at
+    // `mDefragPath`: visit its leaves, look for sub-indices under its keys, or
+    // move on to the sub-indices after it.
+    enum DefragStep : unsigned char { Visit, Descend, Ascend };
+
+    // How far the current pass of `defragment` has got: the trie it is in (0
+    // for the table's own, or one past the index of an ordering), the keys
+    // leading to the sub-index it is at (none for the top level), what it does
+    // next there, and where it is in that sub-index's leaves.
+    std::size_t      mDefragAt;
+    std::vector<Key> mDefragPath;
+    DefragStep       mDefragStep;
+    BTrie::Defrag    mDefrag;
+
+    // Held whilst the table is updated, so that there is one writer at a time.
+    std::mutex mLatch;
+
+    /**
+     * (private) Table::nesting
+     *
+     * @param order The position of each of a table's columns in a global
+     *              ordering.
+     * @return The column held at each level of a trie for that order.
+     */
+    static std::vector<int> nesting(const std::vector<int> &order);
+
+    /**
+     * (private) Table::orderedBy
+     *
+     * @param order The position of each of the table's columns in a global
+     *              ordering.
+     * @return This table, or the secondary ordering of it, that nests its
+     *         columns in the given order.
+     */
+    Table &orderedBy(const std::vector<int> &order);
+
+    /**
+     * (private) Table::defragTrie
+     *
+     * Continue the current pass of `defragment` over this table's own trie
+     * (not its other orderings). The caller must hold the table's latch.
+     *
+     * @param budget  The most leaves to visit.
+     * @param &report The leaves visited and moved are added to this report.
+     * @return True iff the pass visited the trie's last sub-index.
+     */
+    bool defragTrie(int budget, DefragReport &report);
+
+    /**
+     * (private) Table::subIndexAt
+     *
+     * @param path Keys of the levels above a sub-index, from the top.
+     * @return The page ID of the root of the sub-index under those keys, or
+     *         INVALID_PAGE if there is none, or it is held inline.
+     */
+    page_id subIndexAt(const std::vector<Key> &path);
+
+    /**
+     * (private) Table::nextSubIndex
+     *
+     * Move `mDefragPath` on to the next sub-index that `defragment` should
+     * visit, in pre-order, skipping keys whose sub-indices are held inline.
+     * Leaves read along the way count as visited, and if the budget runs out
+     * before a sub-index is found, `mDefragStep` says how to carry on.
+     *
+     * @param until   The number of leaves visited to stop searching at.
+     * @param &report The leaves read are added to this report.
+     * @return False iff every sub-index has been visited.
+     */
+    bool nextSubIndex(long until, DefragReport &report);
+
+    /**
+     * (private) Table::levelOf
+     *
+     * @param column A column of the table.
+     * @return The level of the trie holding that column.
+     */
+    int levelOf(int column) const;
+
+    /**
+     * (private) Table::permute
+     *
+     * Copy a record into `mKeys`, re-arranging its columns into the order of
+     * the levels in the trie.
+     *
+     * @param rec The record.
+     */
+    void permute(const Key *rec);
+
+    /**
+     * (private) Table::insertRecord / Table::removeRecord
+     *
+     * Apply an update to the table's records (and its other orderings) straight
+     * away. The caller must hold the table's latch.
+     *
+     * @param rec A buffer holding the record's columns, in order.
+     * @return True iff the update changed the table.
+     */
+    bool insertRecord(const Key *rec);
+    bool removeRecord(const Key *rec);
+
+    /**
+     * (private) Table::insertBatchInMemory
+     *
+     * Insert a batch of records into a table using the `Memory` engine, by
+     * merging them into its arrays all at once. The caller must hold the
+     * table's latch.
+     *
+     * @param recs  The records, one after the other, with each record's
+     *              columns in order.
+     * @param index The indices of the records, sorted into the order the table
+     *              nests them.
+     * @return The number of records that were not already in the table.
+     */
+    int insertBatchInMemory(const std::vector<Key> &recs,
+                            const std::vector<int> &index);
+
+    /**
+     * (private) Table::strideAt
+     *
+     * @param level The level of nesting.
+     * @return The stride of leaves in the indices at the given level.
+     */
+    int strideAt(int level) const;
+
+    /**
+     * (private) Table::insertAt
+     *
+     * Insert the suffix of `mKeys` starting at the given level into an index.
+     *
+     * @param &pid  The page ID of the root of the index. Updated if the root
+     *              changes.
+     * @param level The level of nesting of the index.
+     * @return True iff the insertion changed the index.
+     */
+    bool insertAt(page_id &pid, int level);
+
+    /**
+     * (private) Table::removeAt
+     *
+     * Remove the suffix of `mKeys` starting at the given level from an index.
+     *
+     * @param &pid  The page ID of the root of the index. Updated if the root
+     *              changes.
+     * @param level The level of nesting of the index.
+     * @return True iff the deletion changed the index.
+     */
+    bool removeAt(page_id &pid, int level);
+
+    /**
+     * (private) Table::cachedRoot
+     *
+     * Find the root of the sub-index of the top level key of `mKeys` in the
+     * cache.
+     *
+     * @param &pid Set to the page ID of the root of the sub-index, if it is
+     *             cached.
+     * @return True iff the sub-index is cached.
+     */
+    bool cachedRoot(page_id &pid);
+
+    /**
+     * (private) Table::relink
+     *
+     * Point the top level key of `mKeys` at a new root for its sub-index, and
+     * cache it.
+     *
+     * @param pid The page ID of the new root of the sub-index.
+     */
+    void relink(page_id pid);
+
+    /**
+     * (private) Table::insertBoxed
+     *
+     * Insert the last key of `mKeys` into a sub-index at the last level, if it
+     * is held in a Container, or should be from now on. Containers whose
+     * encoding cannot hold the key are re-encoded.
+     *
+     * @param &pid       The page ID of the root of the sub-index. Updated if
+     *                   it changes.
+     * @param &didChange Set to true iff the insertion changed the sub-index.
+     * @return False iff the sub-index is (and remains) a BTrie, and should be
+     *         updated as usual.
+     */
+    bool insertBoxed(page_id &pid, bool &didChange);
+
+    /**
+     * (private) Table::removeBoxed
+     *
+     * Remove the last key of `mKeys` from a sub-index at the last level, if it
+     * is held in a Container. Containers left with too few keys to be worth
+     * keeping are turned back into BTries.
+     *
+     * @param &pid       The page ID of the root of the sub-index. Updated if
+     *                   it changes.
+     * @param &didChange Set to true iff the deletion changed the sub-index.
+     * @return False iff the sub-index is a BTrie, and should be updated as
+     *         usual.
+     */
+    bool removeBoxed(page_id &pid, bool &didChange);
+
+    /**
+     * (private) Table::encode
+     *
+     * Create a sub-index at the last level holding the given keys.
+     *
+     * @param keys    The keys, sorted and without duplicates.
+     * @param compact Whether the keys may be held in a Container, if one can
+     *                hold them.
+     * @return The page ID of the root of the new sub-index.
+     */
+    static page_id encode(const std::vector<Key> &keys, bool compact);
+
+    /**
+     * (private) Table::collect
+     *
+     * Append the records in an index whose first column falls in a range to a
+     * buffer, with their columns permuted into levels, as in `mKeys`.
+     *
+     * @param pid   The page ID of the root of the index.
+     * @param level The level of nesting of the index. Keys for the levels above
+     *              it are expected in `mKeys`.
+     * @param lo    The smallest first column value to include (inclusive).
+     * @param hi    The largest first column value to include (inclusive).
+     * @param &out  The buffer to append records to.
+     */
+    void collect(page_id pid, int level, Key lo, Key hi, std::vector<Key> &out);
+
+    /**
+     * (private) Table::collapseRoot
+     *
+     * Replace the root of an index by its only child, if it is an empty branch.
+     *
+     * @param &pid The page ID of the root of the index. Updated if the root
+     *             changes.
+     */
+    static void collapseRoot(page_id &pid);
   };
 }
 
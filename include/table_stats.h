@@ -0,0 +1,107 @@
+#ifndef DB_TABLE_STATS_H
+#define DB_TABLE_STATS_H
+
+#include <map>
+#include <vector>
+
+#include "key.h"
+
+namespace DB {
+  /**
+   * TableStats
+   *
+   * Statistics about the contents of a table, kept up to date as records are
+   * inserted and removed. The degree of a key `x` is the number of records
+   * whose first column is `x`.
+   */
+  struct TableStats {
+
+    /**
+     * TableStats::BUCKETS
+     *
+     * The number of buckets in the degree histogram. Bucket `b` counts the keys
+     * with degree in the range [2^b, 2^(b + 1)).
+     */
+    static constexpr int BUCKETS = 32;
+
+    /**
+     * TableStats::TableStats
+     *
+     * Statistics for an empty table.
+     */
+    TableStats();
+
+    /**
+     * TableStats::getCardinality
+     *
+     * @return The number of records in the table.
+     */
+    long getCardinality() const;
+
+    /**
+     * TableStats::getDistinct
+     *
+     * @return The number of distinct values in the table's first column.
+     */
+    int getDistinct() const;
+
+    /**
+     * TableStats::getDegree
+     *
+     * @param x The value of the first column.
+     * @return The number of records in the table whose first column is `x`.
+     */
+    int getDegree(Key x) const;
+
+    /**
+     * TableStats::getHistogram
+     *
+     * @return The degree histogram, with `BUCKETS` entries.
+     */
+    const std::vector<long> &getHistogram() const;
+
+    /**
+     * TableStats::recordAdded
+     *
+     * Account for a new record in the table.
+     *
+     * @param x The value of the record's first column.
+     */
+    void recordAdded(Key x);
+
+    /**
+     * TableStats::recordRemoved
+     *
+     * Account for a record having been removed from the table.
+     *
+     * @param x The value of the record's first column.
+     */
+    void recordRemoved(Key x);
+
+    /**
+     * TableStats::rangeRemoved
+     *
+     * Account for every record whose first column falls in the range [lo, hi]
+     * having been removed from the table.
+     *
+     * @param lo The smallest first column value removed (inclusive).
+     * @param hi The largest first column value removed (inclusive).
+     */
+    void rangeRemoved(Key lo, Key hi);
+
+  private:
+    long               mCardinality;
+    std::map<Key, int> mDegrees;
+    std::vector<long>  mHistogram;
+
+    /**
+     * (private) TableStats::bucket
+     *
+     * @param degree A positive degree.
+     * @return The histogram bucket the degree falls in.
+     */
+    static int bucket(int degree);
+  };
+}
+
+#endif // DB_TABLE_STATS_H
@@ -1,6 +1,7 @@
 #ifndef DB_TEST_BED_H
 #define DB_TEST_BED_H
 
+#include "dictionary.h"
 #include "query.h"
 
 namespace DB {
@@ -17,8 +18,11 @@ namespace DB {
      * Construct the test bed.
      *
      * @param &query The query to feed updates to.
+     * @param dict   If given, the columns of records are read as strings, and
+     *               encoded through the dictionary (table names are still
+     *               numbers), otherwise columns are integers.
      */
-    TestBed(Query &query);
+    TestBed(Query &query, Dictionary *dict = nullptr);
 
     /**
      * TestBed::runFile
@@ -27,14 +31,18 @@ namespace DB {
      * @param fname The name of the file holding the transactions, in a CSV
      *              format with one transaction on every line. Each transaction
      *              is a table "name" (a number), followed by the transaction's
-     *              record.
+     *              record (with as many columns as the table). Reading stops
+     *              at the first line that is not a transaction, and
+     *              transactions on tables the query does not have are
+     *              skipped.
      * @return The time elapsed in updating the view whilst responding to the
      *         transactions in milliseconds.
      */
     long runFile(Query::Op op, const char *fname);
 
   private:
-    Query &mQuery;
+    Query      &mQuery;
+    Dictionary *mDict;
   };
 }
 
@@ -1,6 +1,8 @@
 #ifndef DB_TRIE_H
 #define DB_TRIE_H
 
+#include "key.h"
+
 namespace DB {
   /**
    * A collection of enums and structs that are shared across both nested B+
@@ -10,9 +12,10 @@ namespace DB {
   /**
    * NodeType
    *
-   * Enum to tag Trie Nodes with their type (Leaf or Branch)
+   * Enum to tag Trie Nodes with their type (Leaf or Branch), or the encoding of
+   * a sub-index held in a Container (Bitmap or Runs).
    */
-  enum NodeType { Branch, Leaf };
+  enum NodeType { Branch, Leaf, Bitmap, Runs };
 
   /**
    * Siblings
@@ -35,8 +38,8 @@ namespace DB {
    */
   struct Family {
     Siblings sibs;
-    int * leftKey;
-    int * rightKey;
+    Key * leftKey;
+    Key * rightKey;
   };
 
   /**
@@ -1,9 +1,12 @@
 #ifndef DB_TRIE_ITERATOR_H
 #define DB_TRIE_ITERATOR_H
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 
+#include "key.h"
+
 namespace DB {
   /**
    * TrieIterator
@@ -20,6 +23,18 @@ namespace DB {
      */
     using Ptr = std::unique_ptr<TrieIterator>;
 
+    /**
+     * TrieIterator::Bits
+     *
+     * A view of keys held in a bitmap: Bit `i` of word `w` is set iff the key
+     * `base + 64 * w + i` is present. `base` is always a multiple of 64.
+     */
+    struct Bits {
+      const uint64_t *words;
+      int count; // Number of words.
+      Key base;
+    };
+
     /**
      * TrieIterator::countingScan
      *
@@ -49,7 +64,7 @@ namespace DB {
      * @param pos The position (current depth) of the iterator. This is intended
      *            to be set by recursive calls to the function.
      */
-    static void traverse(Ptr &it, int depth, int * rec,
+    static void traverse(Ptr &it, int depth, Key * rec,
                          std::function<void(void)> act,
                          int pos = 0);
 
@@ -89,14 +104,14 @@ namespace DB {
      *
      * @param key The given key.
      */
-    virtual void seek(int key) = 0;
+    virtual void seek(Key key) = 0;
 
     /**
      * TrieIterator::key
      *
      * @return the key at the current position (and depth).
      */
-    virtual int  key()   const = 0;
+    virtual Key  key()   const = 0;
 
     /**
      * TrieIterator::atEnd
@@ -113,6 +128,19 @@ namespace DB {
      *         at this depth).
      */
     virtual bool atValidDepth() const = 0;
+
+    /**
+     * TrieIterator::bits
+     *
+     * Iterators whose keys at the current depth are held in a bitmap may expose
+     * it, so that joins can intersect them a word at a time. The view is valid
+     * until the iterator next moves, and may include keys before the current
+     * one.
+     *
+     * @param &out Set to a view of the bitmap, if there is one.
+     * @return True iff the keys at the current depth are held in a bitmap.
+     */
+    virtual bool bits(Bits &out) const;
   };
 }
 
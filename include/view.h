@@ -36,7 +36,7 @@ namespace DB {
      *             that there are atleast as many integers in the buffer as the
      *             records are wide in this View.
      */
-    void insert(int *data);
+    void insert(Key *data);
 
     /**
      * View::remove
@@ -47,7 +47,7 @@ namespace DB {
      *             that there are atleast as many integers in the buffer as the
      *             records are wide in this View.
      */
-    void remove(int *data);
+    void remove(Key *data);
 
     /**
      * View::clear
@@ -74,7 +74,7 @@ namespace DB {
      * @param msg  The transaction type.
      * @param data The associated data buffer.
      */
-    void logTxn(FTree::TxnType msg, int *data);
+    void logTxn(FTree::TxnType msg, Key *data);
   };
 }
 
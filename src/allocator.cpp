@@ -1,5 +1,6 @@
 #include "allocator.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <fcntl.h>
 #include <sstream>
@@ -69,6 +70,20 @@ namespace DB {
     return pid0;
   }
 
+  page_id
+  Allocator::pallocBetween(page_id from, page_id to)
+  {
+    to = std::min<page_id>(to, mSpaceMap.size());
+
+    for (page_id i = from; i < to; ++i)
+      if (!mSpaceMap[i]) {
+        mSpaceMap[i] = true;
+        return i;
+      }
+
+    return INVALID_PAGE;
+  }
+
   void
   Allocator::pfree(page_id pid0, int num)
   {
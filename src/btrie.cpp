@@ -1,15 +1,80 @@
 #include "btrie.h"
 
+#include <algorithm>
+#include <atomic>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #include "allocator.h"
 #include "dim.h"
+#include "snapshot.h"
 
 namespace DB {
 
-  const int BTrie::BRANCH_STRIDE = 2;
-  const int BTrie::BRANCH_SPACE  =
-    (Dim::PAGE_SIZE - offsetof(BTrie, b.data)) / sizeof(int);
-  const int BTrie::LEAF_SPACE    =
-    (Dim::PAGE_SIZE - offsetof(BTrie, l.data)) / sizeof(int);
+  const int BTrie::SPACE      =
+    (Dim::PAGE_SIZE - offsetof(BTrie, data)) / sizeof(Key);
+  const int BTrie::SCAN_WIDTH = 32;
+
+  // Separator key, child page ID and the number of keys under the child.
+  const int BTrie::BRANCH_STRIDE = 3;
+
+  thread_local PageVersions *BTrie::sVersions = nullptr;
+
+  BTrie::Writer::Writer(PageVersions *versions)
+    : mPrev ( sVersions )
+  {
+    sVersions = versions;
+  }
+
+  BTrie::Writer::~Writer()
+  {
+    sVersions = mPrev;
+  }
+
+  BTrie::Reader::Reader(page_id nid, const Snapshot *snapshot)
+    : mPID     ( snapshot ? snapshot->resolve(nid) : nid )
+    , mNode    ( snapshot ? (BTrie *)Global::BUFMGR->pinForReader(mPID)
+                          : load(mPID) )
+    , mIsLive  ( snapshot && mPID == nid )
+    , mVersion ( 0 )
+    , mIsShared ( snapshot != nullptr )
+  {
+    if (!mIsLive)
+      return;
+
+    mVersion = __atomic_load_n(&mNode->version, __ATOMIC_ACQUIRE);
+
+    // The writer may have published an old version between the page being
+    // resolved and its version being read, in which case it may already be
+    // changing the page without bumping its version again.
+    page_id pid = snapshot->resolve(nid);
+    if (pid != nid) {
+      Global::BUFMGR->unpinForReader(mPID);
+      mPID    = pid;
+      mNode   = (BTrie *)Global::BUFMGR->pinForReader(mPID);
+      mIsLive = false;
+    }
+  }
+
+  BTrie::Reader::~Reader()
+  {
+    if (mIsShared)
+      Global::BUFMGR->unpinForReader(mPID);
+    else
+      Global::BUFMGR->unpin(mPID);
+  }
+
+  bool
+  BTrie::Reader::isValid() const
+  {
+    if (!mIsLive)
+      return true;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return __atomic_load_n(&mNode->version, __ATOMIC_RELAXED) == mVersion;
+  }
 
   page_id
   BTrie::leaf(int stride)
@@ -18,11 +83,14 @@ namespace DB {
     page_id lid = Global::BUFMGR->bnew(page);
     BTrie *leaf = (BTrie *)page;
 
-    leaf->type     = Leaf;
-    leaf->count    = 0;
-    leaf->prev     = INVALID_PAGE;
-    leaf->next     = INVALID_PAGE;
-    leaf->l.stride = stride;
+    leaf->type   = Leaf;
+    leaf->count  = 0;
+    leaf->version = 0;
+    leaf->stride = stride;
+    leaf->cap    = capacity(stride);
+    leaf->total  = 0;
+    leaf->prev   = INVALID_PAGE;
+    leaf->next   = INVALID_PAGE;
 
     Global::BUFMGR->unpin(lid, true);
 
@@ -30,68 +98,93 @@ namespace DB {
   }
 
   page_id
-  BTrie::branch(page_id left, int key, page_id right)
+  BTrie::branch(page_id left, Key key, page_id right)
   {
     char *page;
     page_id bid = Global::BUFMGR->bnew(page);
     BTrie *branch = (BTrie *)page;
 
-    branch->type  = Branch;
-    branch->count = 1;
-    branch->prev  = INVALID_PAGE;
-    branch->next  = INVALID_PAGE;
+    branch->type   = Branch;
+    branch->count  = 1;
+    branch->version = 0;
+    branch->stride = BRANCH_STRIDE;
+    branch->cap    = capacity(BRANCH_STRIDE);
+    branch->prev   = INVALID_PAGE;
+    branch->next   = INVALID_PAGE;
 
-    branch->slot(0)[-1] = left;
-    branch->slot(0)[ 0] = key;
-    branch->slot(0)[+1] = right;
+    branch->val(-1) = left;
+    branch->key( 0) = key;
+    branch->val( 0) = right;
+
+    branch->weight(-1) = size(left);
+    branch->weight( 0) = size(right);
+    branch->recount();
 
     Global::BUFMGR->unpin(bid, true);
 
     return bid;
   }
 
-  char *
-  BTrie::onHeap(int stride, int size)
+  BTrie *
+  BTrie::freeNode(char *buf, int stride, int size)
   {
-    std::size_t bytes = offsetof(BTrie, l.data);
-    bytes            += size * stride * sizeof(int);
-
-    char  * buf  = new char[bytes]();
+    std::memset(buf, 0, freeSize(stride, size));
     BTrie * node = (BTrie *)buf;
 
-    node->type     = Leaf;
-    node->count    = size;
-    node->prev     = INVALID_PAGE;
-    node->next     = INVALID_PAGE;
-    node->l.stride = stride;
+    node->type   = Leaf;
+    node->count  = size;
+    node->version = 0;
+    node->stride = stride;
+    node->cap    = size;
+    node->total  = 0;
+    node->prev   = INVALID_PAGE;
+    node->next   = INVALID_PAGE;
 
-    return buf;
+    return node;
   }
 
   BTrie *
   BTrie::load(page_id nid)
   {
-    return (BTrie *)Global::BUFMGR->pin(nid);
+    bool published = sVersions && sVersions->preserve(nid);
+    BTrie *node    = (BTrie *)Global::BUFMGR->pin(nid);
+
+    // Readers that found the live node before the copy was published notice
+    // the bump, and retry against the copy. It must be visible before any of
+    // the changes that follow it.
+    if (published) {
+      __atomic_store_n(&node->version, node->version + 1, __ATOMIC_RELAXED);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    return node;
   }
 
   BTrie::Diff
-  BTrie::reserve(page_id nid, int key, Siblings sibs, page_id &pid, int &keyPos)
+  BTrie::reserve(page_id nid, Key key, Siblings sibs, page_id &pid, int &keyPos,
+                 int appendFill)
   {
     BTrie * node  = load(nid);
     int     pos   = node->findKey(key);
     Diff    split = {};
     split.prop = PROP_NOTHING;
 
+    // Insertions past the last key in the tree are expected to be followed by
+    // more of the same, so full nodes are split unevenly to make room for them,
+    // rather than shuffling keys into their neighbours.
+    bool append = pos == node->count && node->next == INVALID_PAGE;
+    int  fill   = append ? appendFill : 50;
+
     switch (node->type) {
     case Leaf:
       pid = nid;
 
       // Add the key if it is not there.
-      if (pos == node->count || *node->slot(pos) != key) {
+      if (pos == node->count || node->key(pos) != key) {
         split.prop = PROP_CHANGE;
 
         // Try Redistributing Left
-        if (node->isFull() && (LEFT_SIB & sibs)) {
+        if (node->isFull() && !append && (LEFT_SIB & sibs)) {
           BTrie *left = load(node->prev);
 
           if (left->isFull()) {
@@ -113,14 +206,13 @@ namespace DB {
             }
 
             // Shift the nodes over
-            memmove(left->slot(left->count), node->slot(0),
-                    delta * node->l.stride * sizeof(int));
+            moveSlots(left, left->count, node, 0, delta);
             left->count += delta;
             node->makeRoom(delta, -delta);
 
             split.key = pid == node->prev && pos == left->count
               ? key
-              : left->slot(left->count - 1)[0];
+              : left->key(left->count - 1);
 
             // Clean up
             if (pid == nid) {
@@ -133,7 +225,7 @@ namespace DB {
         }
 
         // Try Redistributing Right
-        if (node->isFull() && (RIGHT_SIB & sibs)) {
+        if (node->isFull() && !append && (RIGHT_SIB & sibs)) {
           BTrie *right = load(node->next);
 
           if (right->isFull()) {
@@ -152,13 +244,12 @@ namespace DB {
             }
 
             right->makeRoom(0, delta);
-            memmove(right->slot(0), node->slot(node->count - delta),
-                    delta * node->l.stride * sizeof(int));
+            moveSlots(right, 0, node, node->count - delta, delta);
             node->count -= delta;
 
             split.key = pid == nid && pos == node->count
               ? key
-              : node->slot(node->count - 1)[0];
+              : node->key(node->count - 1);
 
             if (pid == nid) {
               Global::BUFMGR->unpin(node->next, true);
@@ -172,7 +263,7 @@ namespace DB {
         // We have no choice but to split.
         if (node->isFull()) {
           int pivot;
-          split = node->split(nid, pivot);
+          split = node->split(nid, pivot, fill);
 
           if (pos >= pivot) {
             pid  = split.pid;
@@ -185,7 +276,7 @@ namespace DB {
 
         // Make room for slot
         node->makeRoom(pos);
-        *node->slot(pos) = key;
+        node->key(pos) = key;
         Global::BUFMGR->unpin(pid, true);
       } else {
         Global::BUFMGR->unpin(pid);
@@ -194,7 +285,7 @@ namespace DB {
       keyPos = pos;
       break;
     case Branch: {
-      int childPID = node->slot(pos)[-1];
+      page_id childPID = node->val(pos - 1);
 
       Siblings childSibs = NO_SIBS;
       if (pos > 0)            childSibs |= LEFT_SIB;
@@ -203,24 +294,41 @@ namespace DB {
       Global::BUFMGR->unpin(nid);
 
       // Traverse the appropriate child.
-      auto childSplit = reserve(childPID, key, childSibs, pid, keyPos);
+      auto childSplit = reserve(childPID, key, childSibs, pid, keyPos,
+                                appendFill);
 
-      // If we don't need to update this node, then return.
-      if (childSplit.prop != PROP_SPLIT && childSplit.prop != PROP_REDISTRIB) {
+      // If no key was added, we don't need to update this node.
+      if (childSplit.prop == PROP_NOTHING) {
         split = childSplit;
         break;
-      } else {
-        split.prop = PROP_CHANGE;
       }
 
       node = load(nid);
-      // The child redistributed, we just need to update the partitioning key.
+      node->total++;
+
+      // The key was added without changing the shape of the child, so only its
+      // count needs updating.
+      if (childSplit.prop != PROP_SPLIT && childSplit.prop != PROP_REDISTRIB) {
+        node->weight(pos - 1)++;
+        Global::BUFMGR->unpin(nid, true);
+
+        split = childSplit;
+        break;
+      }
+
+      split.prop = PROP_CHANGE;
+      node->weight(pos - 1) = size(childPID);
+
+      // The child redistributed, we just need to update the partitioning key,
+      // and the count of the sibling it shared its keys with.
       if (childSplit.prop == PROP_REDISTRIB) {
+        int sibPos = childSplit.sib == RIGHT_SIB ? pos : pos - 2;
         if (childSplit.sib == RIGHT_SIB)
-          node->slot(pos)[0] = childSplit.key;
+          node->key(pos) = childSplit.key;
         else
-          node->slot(pos - 1)[0] = childSplit.key;
+          node->key(pos - 1) = childSplit.key;
 
+        node->weight(sibPos) = size(node->val(sibPos));
         Global::BUFMGR->unpin(nid, true);
         break;
       }
@@ -229,7 +337,7 @@ namespace DB {
       // split ourselves).
       if (node->isFull()) {
         int pivot;
-        split = node->split(nid, pivot);
+        split = node->split(nid, pivot, fill);
 
         if (pos > pivot) {
           pos -= pivot + 1;
@@ -240,338 +348,664 @@ namespace DB {
       }
 
       node->makeRoom(pos);
-      node->slot(pos)[0] = childSplit.key;
-      node->slot(pos)[1] = childSplit.pid;
+      node->key(pos)    = childSplit.key;
+      node->val(pos)    = childSplit.pid;
+      node->weight(pos) = size(childSplit.pid);
+      node->recount();
       Global::BUFMGR->unpin(nid, true);
 
       break;
     }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
 
     return split;
   }
 
   BTrie::Diff
-  BTrie::deleteIf(page_id nid, int key,
-                  Family family,
-                  std::function<bool(page_id, int)> predicate)
+  BTrie::deleteSlot(page_id nid, BTrie *node, int pos, Family family, int n)
   {
-    BTrie * node = load(nid);
-    int     pos  = node->findKey(key);
-    Diff    diff = {};
-    diff.prop = PROP_NOTHING;
+    // Delete the slots
+    Diff diff = {};
+    diff.prop = PROP_CHANGE;
+    node->makeRoom(pos + n, -n);
 
-    switch (node->type) {
-    case Leaf:
-      if (pos == node->count
-          || node->slot(pos)[0] != key
-          || !predicate(nid, pos)
-          ) {
-        Global::BUFMGR->unpin(nid);
-        break;
-      }
+    if (!node->isUnderOccupied()) {
+      Global::BUFMGR->unpin(nid, true);
+      return diff;
+    }
 
-      // Delete the slot
-      diff.prop = PROP_CHANGE;
-      node->makeRoom(pos + 1, -1);
+    // Slots are only taken from a sibling that is too full to merge with.
+
+    // Try Redistributing Left
+    if (family.sibs & LEFT_SIB) {
+      BTrie *left = load(node->prev);
+
+      if (left->canAbsorb(node)) {
+        Global::BUFMGR->unpin(node->prev);
+      } else {
+        diff.prop = PROP_REDISTRIB;
+        diff.sib  = LEFT_SIB;
+
+        int total = node->count + left->count;
+        int delta = (total - 1) / 2 - node->count + 1;
+
+        node->makeRoom(0, delta);
+        moveSlots(node, 0, left, left->count - delta, delta);
+        left->count -= delta;
+
+        diff.key = left->key(left->count - 1);
 
-      if (!node->isUnderOccupied()) {
+        Global::BUFMGR->unpin(node->prev, true);
         Global::BUFMGR->unpin(nid, true);
-        break;
+        return diff;
       }
+    }
 
-      // Try Redistributing Left
-      if (family.sibs & LEFT_SIB) {
-        BTrie *left = load(node->prev);
+    // Try Redistributing Right
+    if (family.sibs & RIGHT_SIB) {
+      BTrie *right = load(node->next);
 
-        if (left->isUnderOccupied()) {
-          Global::BUFMGR->unpin(node->prev);
-        } else {
-          diff.prop = PROP_REDISTRIB;
-          diff.sib  = LEFT_SIB;
+      if (node->canAbsorb(right)) {
+        Global::BUFMGR->unpin(node->next);
+      } else {
+        diff.prop = PROP_REDISTRIB;
+        diff.sib  = RIGHT_SIB;
 
-          int total = node->count + left->count;
-          int delta = (total - 1) / 2 - node->count + 1;
+        int total = node->count + right->count;
+        int delta = (total - 1) / 2 - node->count + 1;
 
-          node->makeRoom(0, delta);
-          memmove(node->slot(0), left->slot(left->count - delta),
-                  delta * node->l.stride * sizeof(int));
-          left->count -= delta;
+        moveSlots(node, node->count, right, 0, delta);
+        node->count += delta;
+        right->makeRoom(delta, -delta);
 
-          diff.key = left->slot(left->count - 1)[0];
+        diff.key = node->key(node->count - 1);
 
-          Global::BUFMGR->unpin(node->prev, true);
-          Global::BUFMGR->unpin(nid, true);
-          break;
-        }
+        Global::BUFMGR->unpin(node->next, true);
+        Global::BUFMGR->unpin(nid, true);
+        return diff;
       }
+    }
 
-      // Try Redistributing Right
-      if (family.sibs & RIGHT_SIB) {
-        BTrie *right = load(node->next);
+    // Try Merging Left
+    if (family.sibs & LEFT_SIB) {
+      page_id lid = node->prev;
+      BTrie *left = load(lid);
+      diff.prop = PROP_MERGE;
+      diff.sib  = LEFT_SIB;
 
-        if (right->isUnderOccupied()) {
-          Global::BUFMGR->unpin(node->next);
-        } else {
-          diff.prop = PROP_REDISTRIB;
-          diff.sib  = RIGHT_SIB;
+      left->merge(lid, node, *family.leftKey);
 
-          int total = node->count + right->count;
-          int delta = (total - 1) / 2 - node->count + 1;
+      Global::BUFMGR->unpin(lid, true);
+      Global::BUFMGR->unpin(nid);
+      return diff;
+    }
 
-          memmove(node->slot(node->count), right->slot(0),
-                  delta * node->l.stride * sizeof(int));
-          node->count += delta;
-          right->makeRoom(delta, -delta);
+    // Try Merging Right
+    if (family.sibs & RIGHT_SIB) {
+      page_id rid  = node->next;
+      BTrie *right = load(rid);
+      diff.prop = PROP_MERGE;
+      diff.sib  = RIGHT_SIB;
 
-          diff.key = node->slot(node->count - 1)[0];
+      node->merge(nid, right, *family.rightKey);
 
-          Global::BUFMGR->unpin(node->next, true);
-          Global::BUFMGR->unpin(nid, true);
-          break;
-        }
-      }
+      Global::BUFMGR->unpin(nid, true);
+      Global::BUFMGR->unpin(rid);
+      return diff;
+    }
 
-      // Try Merging Left
-      if (family.sibs & LEFT_SIB) {
-        page_id lid = node->prev;
-        BTrie *left = load(lid);
-        diff.prop = PROP_MERGE;
-        diff.sib  = LEFT_SIB;
+    Global::BUFMGR->unpin(nid, true);
+    return diff;
+  }
 
-        left->merge(lid, node, *family.leftKey);
+  BTrie::Diff
+  BTrie::fixChild(page_id nid, BTrie *node, int pos, Family family,
+                  Diff childDiff, int removed)
+  {
+    // If no key was removed, we don't need to update this node.
+    if (childDiff.prop == PROP_NOTHING) {
+      Global::BUFMGR->unpin(nid);
+      return childDiff;
+    }
 
-        Global::BUFMGR->unpin(lid, true);
-        Global::BUFMGR->unpin(nid);
-        break;
-      }
+    node->total -= removed;
 
-      // Try Merging Right
-      if (family.sibs & RIGHT_SIB) {
-        page_id rid  = node->next;
-        BTrie *right = load(rid);
-        diff.prop = PROP_MERGE;
-        diff.sib  = RIGHT_SIB;
+    // The keys were removed without changing the shape of the child, so only
+    // its count needs updating.
+    if (childDiff.prop != PROP_MERGE && childDiff.prop != PROP_REDISTRIB) {
+      node->weight(pos - 1) -= removed;
+      Global::BUFMGR->unpin(nid, true);
+      return childDiff;
+    }
 
-        node->merge(nid, right, *family.rightKey);
+    Diff diff = {};
+    diff.prop = PROP_CHANGE;
 
-        Global::BUFMGR->unpin(nid, true);
-        Global::BUFMGR->unpin(rid);
-        break;
-      }
+    // Fix the partitioning key in the case of a redistribution, and the counts
+    // of the child and the sibling it took keys from.
+    if (childDiff.prop == PROP_REDISTRIB) {
+      int sibPos = childDiff.sib == RIGHT_SIB ? pos : pos - 2;
+      if (childDiff.sib == RIGHT_SIB)
+        node->key(pos) = childDiff.key;
+      else
+        node->key(pos - 1) = childDiff.key;
 
+      node->weight(pos - 1) = size(node->val(pos - 1));
+      node->weight(sibPos)  = size(node->val(sibPos));
       Global::BUFMGR->unpin(nid, true);
-      break;
-    case Branch: {
-      int childPID = node->slot(pos)[-1];
+      return diff;
+    }
 
-      Family childFamily {};
-      if (pos > 0) {
-        childFamily.sibs    |= LEFT_SIB;
-        childFamily.leftKey  = node->slot(pos - 1);
-      }
+    // Otherwise we must deal with a merge, after which the surviving node holds
+    // the keys of both.
+    if (childDiff.sib == RIGHT_SIB) {
+      page_id toFree = node->val(pos);
 
-      if (pos < node->count) {
-        childFamily.sibs |= RIGHT_SIB;
-        childFamily.rightKey = node->slot(pos);
-      }
+      node->makeRoom(pos + 1, -1);
+      Global::BUFMGR->bfree(toFree);
+      node->weight(pos - 1) = size(node->val(pos - 1));
+    } else if (childDiff.sib == LEFT_SIB) {
+      page_id toFree = node->val(pos - 1);
+
+      node->makeRoom(pos, -1);
+      Global::BUFMGR->bfree(toFree);
+      node->weight(pos - 2) = size(node->val(pos - 2));
+    }
 
-      // Traverse the appropriate child.
-      Diff childDiff = deleteIf(childPID, key, childFamily, predicate);
+    if (!node->isUnderOccupied()) {
+      Global::BUFMGR->unpin(nid, true);
+      return diff;
+    }
 
-      // If we don't need to update this node, then return.
-      if (childDiff.prop != PROP_MERGE && childDiff.prop != PROP_REDISTRIB) {
-        Global::BUFMGR->unpin(nid);
-        diff = childDiff;
-        break;
+    // Slots are only taken from a sibling that is too full to merge with.
+
+    // Try Redistributing Left
+    if (family.sibs & LEFT_SIB) {
+      BTrie *left = load(node->prev);
+
+      if (left->canAbsorb(node)) {
+        Global::BUFMGR->unpin(node->prev);
       } else {
-        diff.prop = PROP_CHANGE;
-      }
+        diff.prop = PROP_REDISTRIB;
+        diff.sib  = LEFT_SIB;
 
-      // Fix the partitioning key in the case of a redistribution.
-      if (childDiff.prop == PROP_REDISTRIB) {
-        if (childDiff.sib == RIGHT_SIB)
-          node->slot(pos)[0] = childDiff.key;
-        else
-          node->slot(pos - 1)[0] = childDiff.key;
+        int total = node->count + left->count;
+        int delta = (total - 1)/ 2 - node->count + 1;
+
+        // The partitioning key comes down from the parent, and the last key
+        // moved over from the left goes up to replace it.
+        node->makeRoom(0, delta);
+        node->key(delta - 1)    = *family.leftKey;
+        node->val(delta - 1)    = node->val(-1);
+        node->weight(delta - 1) = node->weight(-1);
+        moveSlots(node, 0, left, left->count - delta + 1, delta - 1);
+        node->val(-1)    = left->val(left->count - delta);
+        node->weight(-1) = left->weight(left->count - delta);
+        left->count -= delta;
+
+        left->recount();
+        node->recount();
 
+        diff.key = left->key(left->count);
+
+        Global::BUFMGR->unpin(node->prev, true);
         Global::BUFMGR->unpin(nid, true);
-        break;
+        return diff;
       }
+    }
+
+    // Try Redistributing Right
+    if (family.sibs & RIGHT_SIB) {
+      BTrie *right = load(node->next);
 
-      // Otherwise we must deal with a merge.
-      if (childDiff.sib == RIGHT_SIB) {
-        int toFree = node->slot(pos)[+1];
+      if (node->canAbsorb(right)) {
+        Global::BUFMGR->unpin(node->next);
+      } else {
+        diff.prop = PROP_REDISTRIB;
+        diff.sib  = RIGHT_SIB;
 
-        node->makeRoom(pos + 1, -1);
-        Global::BUFMGR->bfree(toFree);
-      } else if (childDiff.sib == LEFT_SIB) {
-        int toFree = node->slot(pos)[-1];
+        int total = node->count + right->count;
+        int delta = (total - 1) / 2 - node->count + 1;
 
-        node->makeRoom(pos, -1);
-        Global::BUFMGR->bfree(toFree);
-      }
+        node->key(node->count)    = *family.rightKey;
+        node->val(node->count)    = right->val(-1);
+        node->weight(node->count) = right->weight(-1);
+        moveSlots(node, node->count + 1, right, 0, delta - 1);
+        node->count += delta;
+
+        diff.key          = right->key(delta - 1);
+        right->val(-1)    = right->val(delta - 1);
+        right->weight(-1) = right->weight(delta - 1);
+
+        right->makeRoom(delta, -delta);
 
-      if (!node->isUnderOccupied()) {
+        node->recount();
+        right->recount();
+
+        Global::BUFMGR->unpin(node->next, true);
         Global::BUFMGR->unpin(nid, true);
-        break;
+        return diff;
       }
+    }
 
-      // Try Redistributing Left
-      if (family.sibs & LEFT_SIB) {
-        BTrie *left = load(node->prev);
+    // Try Merging Left
+    if (family.sibs & LEFT_SIB) {
+      page_id lid = node->prev;
+      BTrie *left = load(lid);
+      diff.prop   = PROP_MERGE;
+      diff.sib    = LEFT_SIB;
 
-        if (left->isUnderOccupied()) {
-          Global::BUFMGR->unpin(node->prev);
-        } else {
-          diff.prop = PROP_REDISTRIB;
-          diff.sib  = LEFT_SIB;
+      left->merge(lid, node, *family.leftKey);
 
-          int total = node->count + left->count;
-          int delta = (total - 1)/ 2 - node->count + 1;
+      Global::BUFMGR->unpin(lid, true);
+      Global::BUFMGR->unpin(nid);
+      return diff;
+    }
 
-          node->makeRoom(0, delta);
-          node->slot(delta - 1)[0] = *family.leftKey;
-          node->slot(delta - 1)[1] = node->slot(0)[-1];
-          memmove(node->slot(0) - 1, left->slot(left->count - delta) + 1,
-                  (delta * BRANCH_STRIDE - 1) * sizeof(int));
-          left->count -= delta;
+    // Try Merging Right
+    if (family.sibs & RIGHT_SIB) {
+      page_id rid  = node->next;
+      BTrie *right = load(rid);
+      diff.prop    = PROP_MERGE;
+      diff.sib     = RIGHT_SIB;
 
-          diff.key = left->slot(left->count)[0];
+      node->merge(nid, right, *family.rightKey);
+      Global::BUFMGR->unpin(nid, true);
+      Global::BUFMGR->unpin(rid);
+      return diff;
+    }
 
-          Global::BUFMGR->unpin(node->prev, true);
-          Global::BUFMGR->unpin(nid, true);
-          break;
+    // Without siblings, this is the root, and it may have been left with only
+    // one child, which should replace it.
+    diff.prop = PROP_MERGE;
+    Global::BUFMGR->unpin(nid, true);
+    return diff;
+  }
+
+  void
+  BTrie::find(page_id nid, Key key, page_id &foundPID, int &foundPos,
+              const Snapshot *snapshot)
+  {
+    // A node that changed whilst it was read is read again, rather than
+    // restarting from the root: its parent was the version the snapshot sees,
+    // so the node it references is still the right one.
+    for (;;) {
+      Reader  node(nid, snapshot);
+      int     pos = node->findKey(key);
+      page_id pid;
+
+      switch (node->type) {
+      case Leaf:
+        if (pos >= node->count &&
+            node->next != INVALID_PAGE) {
+          pid = node->next;
+          pos = 0;
+        } else {
+          pid = nid;
         }
+
+        if (node.isValid()) {
+          foundPID = pid;
+          foundPos = pos;
+          return;
+        }
+        break;
+      case Branch:
+        pid = node->val(pos - 1);
+        if (node.isValid())
+          nid = pid;
+        break;
+      case Bitmap:
+      case Runs:
+        // Containers hold no slots to search.
+        foundPID = nid;
+        foundPos = 0;
+        return;
+      default:
+        throw std::runtime_error("Unrecognised Node Type");
       }
+    }
+  }
 
-      // Try Redistributing Right
-      if (family.sibs & RIGHT_SIB) {
-        BTrie *right = load(node->next);
+  void
+  BTrie::findMany(page_id nid, const std::vector<Key> &keys,
+                  std::vector<page_id> &foundPIDs, std::vector<int> &foundPos,
+                  const Snapshot *snapshot)
+  {
+    foundPIDs.resize(keys.size());
+    foundPos.resize(keys.size());
 
-        if (right->isUnderOccupied()) {
-          Global::BUFMGR->unpin(node->next);
-        } else {
-          diff.prop = PROP_REDISTRIB;
-          diff.sib  = RIGHT_SIB;
+    if (!keys.empty())
+      findMany(nid, keys.data(), keys.size(),
+               foundPIDs.data(), foundPos.data(), snapshot);
+  }
 
-          int total = node->count + right->count;
-          int delta = (total - 1) / 2 - node->count + 1;
+  void
+  BTrie::findMany(page_id nid, const Key *keys, int n,
+                  page_id *foundPIDs, int *foundPos,
+                  const Snapshot *snapshot)
+  {
+    // The children to descend into, with the index just past the last key
+    // bound for each. They are only visited once the node has been released,
+    // so that no more than one node is pinned at a time.
+    std::vector<std::pair<page_id, int>> parts;
+    bool isLeaf;
+
+    for (;;) {
+      Reader node(nid, snapshot);
+      parts.clear();
+
+      switch (node->type) {
+      case Leaf:
+        isLeaf = true;
+        for (int i = 0; i < n; ++i) {
+          int pos = node->findKey(keys[i]);
+
+          if (pos >= node->count &&
+              node->next != INVALID_PAGE) {
+            foundPIDs[i] = node->next;
+            foundPos[i]  = 0;
+          } else {
+            foundPIDs[i] = nid;
+            foundPos[i]  = pos;
+          }
+        }
+        break;
+      case Branch:
+        // The child at `pos - 1` holds the keys up to and including the
+        // partitioning key at `pos`.
+        isLeaf = false;
+        for (int i = 0; i < n;) {
+          int pos = node->findKey(keys[i]);
+          int end = pos >= node->count
+            ? n
+            : std::upper_bound(keys + i, keys + n, node->key(pos)) - keys;
+
+          parts.emplace_back(node->val(pos - 1), end);
+          i = end;
+        }
+        break;
+      case Bitmap:
+      case Runs:
+        for (int i = 0; i < n; ++i) {
+          foundPIDs[i] = nid;
+          foundPos[i]  = 0;
+        }
+        return;
+      default:
+        throw std::runtime_error("Unrecognised Node Type");
+      }
 
-          node->slot(node->count)[0] = *family.rightKey;
-          memmove(node->slot(node->count) + 1, right->slot(0) - 1,
-                  (delta * BRANCH_STRIDE - 1) * sizeof(int));
-          node->count += delta;
+      if (node.isValid())
+        break;
+    }
 
-          diff.key           = right->slot(delta - 1)[0];
-          right->slot(0)[-1] = right->slot(delta)[-1];
+    if (isLeaf)
+      return;
 
-          right->makeRoom(delta, -delta);
+    int begin = 0;
+    for (const auto &part : parts) {
+      findMany(part.first, keys + begin, part.second - begin,
+               foundPIDs + begin, foundPos + begin, snapshot);
+      begin = part.second;
+    }
+  }
 
-          Global::BUFMGR->unpin(node->next, true);
-          Global::BUFMGR->unpin(nid, true);
-          break;
+  bool
+  BTrie::defragment(page_id nid, Defrag &pass, int budget,
+                    DefragReport &report)
+  {
+    while (budget > 0) {
+      // Find the leaf holding the smallest key left to visit, and its place
+      // in its parent.
+      page_id lid    = nid;
+      page_id parent = INVALID_PAGE;
+      int     slot   = 0;
+      BTrie * leaf   = (BTrie *)Global::BUFMGR->pin(lid);
+
+      while (leaf->type == Branch) {
+        parent = lid;
+        slot   = leaf->findKey(pass.key) - 1;
+        lid    = leaf->val(slot);
+
+        Global::BUFMGR->unpin(parent);
+        leaf = (BTrie *)Global::BUFMGR->pin(lid);
+      }
+
+      if (leaf->type != Leaf || parent == INVALID_PAGE) {
+        // The root is a leaf (or a container), and stays where it is.
+        Global::BUFMGR->unpin(lid);
+        pass = Defrag();
+        return true;
+      }
+
+      page_id prev = leaf->prev;
+      page_id next = leaf->next;
+      Key     last = leaf->key(leaf->count - 1);
+
+      // Every key in the leaf has been visited, so the next leaf holds the
+      // first key left to visit.
+      if (last < pass.key) {
+        Global::BUFMGR->unpin(lid);
+        if (next == INVALID_PAGE) {
+          pass = Defrag();
+          return true;
         }
+
+        BTrie *right = (BTrie *)Global::BUFMGR->pin(next);
+        pass.key = right->key(0);
+        Global::BUFMGR->unpin(next);
+        continue;
       }
 
-      // Try Merging Left
-      if (family.sibs & LEFT_SIB) {
-        page_id lid = node->prev;
-        BTrie *left = load(lid);
-        diff.prop   = PROP_MERGE;
-        diff.sib    = LEFT_SIB;
+      Global::BUFMGR->unpin(lid);
+
+      page_id at = lid;
+      if (pass.last != INVALID_PAGE && lid != pass.last + 1) {
+        char   *page;
+        page_id to = Global::BUFMGR->bnewBetween(
+          page, pass.last + 1,
+          lid < pass.last ? INVALID_PAGE : lid);
+
+        if (to != INVALID_PAGE) {
+          // Preserve the old page for readers of snapshots, which may still
+          // find it through (old versions of) its parent or neighbours.
+          BTrie *old = load(lid);
+          memcpy(page, old, Dim::PAGE_SIZE);
+          Global::BUFMGR->unpin(lid);
+          Global::BUFMGR->unpin(to, true);
+
+          BTrie *node = load(parent);
+          node->val(slot) = to;
+          Global::BUFMGR->unpin(parent, true);
+
+          if (prev != INVALID_PAGE) {
+            node = load(prev);
+            node->next = to;
+            Global::BUFMGR->unpin(prev, true);
+          }
 
-        left->merge(lid, node, *family.leftKey);
+          if (next != INVALID_PAGE) {
+            node = load(next);
+            node->prev = to;
+            Global::BUFMGR->unpin(next, true);
+          }
 
-        Global::BUFMGR->unpin(lid, true);
-        Global::BUFMGR->unpin(nid);
-        break;
+          Global::BUFMGR->bfree(lid);
+          report.moved++;
+          at = to;
+        }
       }
 
-      // Try Merging Right
-      if (family.sibs & RIGHT_SIB) {
-        page_id rid  = node->next;
-        BTrie *right = load(rid);
-        diff.prop    = PROP_MERGE;
-        diff.sib     = RIGHT_SIB;
+      if (pass.was != INVALID_PAGE && lid != pass.was + 1)
+        report.gapsBefore++;
 
-        node->merge(nid, right, *family.rightKey);
-        Global::BUFMGR->unpin(nid, true);
-        Global::BUFMGR->unpin(rid);
-        break;
+      if (pass.last != INVALID_PAGE && at != pass.last + 1)
+        report.gapsAfter++;
+
+      report.visited++;
+      budget--;
+
+      if (next == INVALID_PAGE) {
+        pass = Defrag();
+        return true;
       }
 
-      Global::BUFMGR->unpin(nid, true);
-      break;
+      pass.key  = last + 1;
+      pass.last = at;
+      pass.was  = lid;
     }
+
+    return false;
+  }
+
+  void
+  BTrie::copy(page_id nid, const Snapshot *snapshot, BTrie *dst)
+  {
+    for (;;) {
+      Reader node(nid, snapshot);
+      memcpy(dst, node.get(), Dim::PAGE_SIZE);
+
+      if (node.isValid())
+        return;
     }
+  }
 
-    return diff;
+  void
+  BTrie::destroy(page_id nid)
+  {
+    BTrie *node = load(nid);
+
+    switch (node->type) {
+    case Leaf:
+      // Only leaves with values have sub-indices.
+      if (node->stride > 1)
+        for (int i = 0; i < node->count; ++i)
+          if (node->inlineCount(i) == 0)
+            destroy(node->val(i));
+      break;
+    case Branch:
+      for (int i = -1; i < node->count; ++i)
+        destroy(node->val(i));
+      break;
+    case Bitmap:
+    case Runs:
+      // Containers hold no sub-indices of their own.
+      break;
+    }
+
+    Global::BUFMGR->unpin(nid);
+    Global::BUFMGR->bfree(nid);
+  }
+
+  int
+  BTrie::size(page_id nid)
+  {
+    BTrie *node  = load(nid);
+    int    total = node->getTotal();
+    Global::BUFMGR->unpin(nid);
+
+    return total;
+  }
+
+  int
+  BTrie::rank(page_id nid, Key key)
+  {
+    BTrie *node = load(nid);
+    int    pos  = node->findKey(key);
+
+    switch (node->type) {
+    case Leaf:
+      Global::BUFMGR->unpin(nid);
+      return pos;
+    case Branch: {
+      // Every key in the children left of the one we descend into is smaller.
+      int before = 0;
+      for (int i = -1; i < pos - 1; ++i)
+        before += node->weight(i);
+
+      page_id childPID = node->val(pos - 1);
+      Global::BUFMGR->unpin(nid);
+      return before + rank(childPID, key);
+    }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
   }
 
   void
-  BTrie::find(page_id nid, int key, page_id &foundPID, int &foundPos)
+  BTrie::select(page_id nid, int index, page_id &foundPID, int &foundPos)
   {
-    BTrie * node = load(nid);
-    int     pos  = node->findKey(key);
+    BTrie *node = load(nid);
 
     switch (node->type) {
     case Leaf:
-      if (pos >= node->count &&
-          node->next != INVALID_PAGE) {
-        foundPID = node->next;
-        foundPos = 0;
-      } else {
-        foundPID = nid;
-        foundPos = pos;
-      }
+      foundPID = nid;
+      foundPos = index;
       Global::BUFMGR->unpin(nid);
       break;
     case Branch: {
-      int childPID = node->slot(pos)[-1];
+      // Skip over children until the one holding the key at `index`.
+      int i = -1;
+      while (i < node->count - 1 && index >= node->weight(i))
+        index -= node->weight(i++);
+
+      page_id childPID = node->val(i);
       Global::BUFMGR->unpin(nid);
-      find(childPID, key, foundPID, foundPos);
+      select(childPID, index, foundPID, foundPos);
       break;
     }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
   }
 
   BTrie::Diff
-  BTrie::split(page_id pid, int &pivot)
+  BTrie::split(page_id pid, int &pivot, int fill)
   {
     // Allocate a new page
     char *page;
     page_id nid = Global::BUFMGR->bnew(page);
     BTrie *node = (BTrie *)page;
-    node->type = type;
+    node->type    = type;
+    node->version = 0;
+    node->stride  = stride;
+    node->cap     = cap;
 
     Diff diff {};
     diff.prop = PROP_SPLIT;
     diff.pid  = nid;
 
-    pivot = count / 2;
+    pivot = std::max(count / 2, count * fill / 100);
     switch (type) {
     case Leaf:
       // Move half the records.
-      memmove(node->slot(0), slot(pivot),
-              (count - pivot) * l.stride * sizeof(int));
+      moveSlots(node, 0, this, pivot, count - pivot);
 
-      node->count    = count - pivot;
-      count          = pivot;
-      node->l.stride = l.stride;
+      node->count = count - pivot;
+      count       = pivot;
 
-      diff.key = slot(pivot - 1)[0];
+      diff.key = key(pivot - 1);
       break;
     case Branch:
       // Move half the children, excluding the pivot key, which we push up.
-      memmove(node->slot(0) - 1, slot(pivot + 1) - 1,
-              ((count - pivot) * BRANCH_STRIDE - 1) * sizeof(int));
+      pivot = std::min(pivot, count - 1);
+      node->val(-1)    = val(pivot);
+      node->weight(-1) = weight(pivot);
+      moveSlots(node, 0, this, pivot + 1, count - pivot - 1);
 
       node->count = count - pivot - 1;
       count       = pivot;
 
-      diff.key = slot(pivot)[0];
+      recount();
+      node->recount();
+
+      diff.key = key(pivot);
       break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
 
     // Fix the neighbour pointers.
@@ -591,20 +1025,23 @@ namespace DB {
   }
 
   void
-  BTrie::merge(page_id nid, BTrie *that, int part)
+  BTrie::merge(page_id nid, BTrie *that, Key part)
   {
     switch (type) {
     case Leaf:
-      memmove(slot(count), that->slot(0),
-              that->count * l.stride * sizeof(int));
+      moveSlots(this, count, that, 0, that->count);
       count += that->count;
       break;
     case Branch:
-      slot(count)[0] = part;
-      memmove(slot(count) + 1, that->slot(0) - 1,
-              (1 + that->count * BRANCH_STRIDE) * sizeof(int));
+      key(count)    = part;
+      val(count)    = that->val(-1);
+      weight(count) = that->weight(-1);
+      moveSlots(this, count + 1, that, 0, that->count);
       count += that->count + 1;
+      total += that->total;
       break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
 
     // Fix neighbour pointers
@@ -629,6 +1066,13 @@ namespace DB {
     return count;
   }
 
+  int
+  BTrie::getTotal() const
+  {
+    // Leaves (and containers) hold their keys directly.
+    return type == Branch ? total : count;
+  }
+
   page_id
   BTrie::getPrev() const
   {
@@ -649,55 +1093,187 @@ namespace DB {
 
   bool
   BTrie::isFull() const
+  {
+    return count >= cap;
+  }
+
+  bool
+  BTrie::isUnderOccupied() const
   {
     switch (type) {
     case Leaf:
-      return count >= LEAF_SPACE / l.stride;
+      return count <= cap * Dim::MERGE_FILL / 100;
     case Branch:
-      return count >= (BRANCH_SPACE - 1) / BRANCH_STRIDE;
+      return count <= (cap - 1) * Dim::MERGE_FILL / 100;
     default:
       throw std::runtime_error("Unrecognised Node Type");
     }
   }
 
   bool
-  BTrie::isUnderOccupied() const
+  BTrie::canAbsorb(const BTrie *that) const
   {
     switch (type) {
     case Leaf:
-      return count <= LEAF_SPACE / l.stride / 2;
+      return count + that->count <= cap;
     case Branch:
-      return count <= ((BRANCH_SPACE - 1) / BRANCH_STRIDE - 1) / 2;
+      // The partitioning key comes down from the parent too.
+      return count + that->count + 1 <= cap;
     default:
       throw std::runtime_error("Unrecognised Node Type");
     }
   }
 
-  int *
-  BTrie::slot(int index)
+  int
+  BTrie::inlineCount(int index)
   {
-    switch (type) {
-    case Leaf:
-      return &l.data[l.stride * index];
-    case Branch:
-      return &b.data[1 + BRANCH_STRIDE * index];
+    return val(index) < 0 ? -val(index) : 0;
+  }
+
+  void
+  BTrie::setInlineCount(int index, int n)
+  {
+    val(index) = -n;
+  }
+
+  void
+  BTrie::unpack(int index, BTrie *dst)
+  {
+    dst->count = inlineCount(index);
+    for (int j = 0; j < dst->count; ++j)
+      dst->key(j) = inlineKey(index, j);
+  }
+
+  int
+  BTrie::capacity(int stride)
+  {
+    // Every column but the first has an extra entry, for index -1.
+    return (SPACE - stride + 1) / stride;
+  }
+
+  void
+  BTrie::recount()
+  {
+    total = 0;
+    for (int i = -1; i < count; ++i)
+      total += weight(i);
+  }
+
+  void
+  BTrie::moveSlots(BTrie *dst, int dstIdx, BTrie *src, int srcIdx, int n)
+  {
+    static_assert(Dim::INLINE_SIZE > 0,
+                  "Root leaves must have room for atleast one inline key.");
+    static_assert(Dim::INLINE_SIZE != 1,
+                  "Leaves with inline sub-indices must not share the stride "
+                  "of branches.");
+
+    if (n <= 0) return;
+
+    switch (src->stride) {
+    case 1:
+      moveSlots<1>(dst, dstIdx, src, srcIdx, n);
+      break;
+    case 2:
+      moveSlots<2>(dst, dstIdx, src, srcIdx, n);
+      break;
+    case 3:
+      moveSlots<3>(dst, dstIdx, src, srcIdx, n);
+      break;
+    case 2 + Dim::INLINE_SIZE:
+      moveSlots<2 + Dim::INLINE_SIZE>(dst, dstIdx, src, srcIdx, n);
+      break;
     default:
-      throw std::runtime_error("Unrecognised Node Type");
+      throw std::runtime_error("Unrecognised Stride");
     }
   }
 
+  template <int Stride>
+  void
+  BTrie::moveSlots(BTrie *dst, int dstIdx, BTrie *src, int srcIdx, int n)
+  {
+    memmove(&dst->key(dstIdx), &src->key(srcIdx), n * sizeof(Key));
+
+    for (int c = 1; c < Stride; ++c)
+      memmove(&dst->col(c, dstIdx), &src->col(c, srcIdx), n * sizeof(Key));
+  }
+
   int
-  BTrie::findKey(int key)
+  BTrie::findKey(Key searchKey)
   {
     int lo = 0, hi = count;
 
-    while(lo < hi) {
+    while (hi - lo > SCAN_WIDTH) {
+      int m = lo + (hi - lo) / 2;
+
+      if (searchKey <= data[m]) hi = m;
+      else                      lo = m + 1;
+    }
+
+    return scanKeys(searchKey, lo, hi);
+  }
+
+  int
+  BTrie::gallop(Key searchKey, int from)
+  {
+    // Every slot before `lo` holds a smaller key, and the key at `hi` (if
+    // there is one) is not smaller.
+    int lo = from, hi = from, stride = 1;
+    while (hi < count && data[hi] < searchKey) {
+      lo      = hi + 1;
+      hi      = std::min(count, hi + stride);
+      stride *= 2;
+    }
+
+    while (hi - lo > SCAN_WIDTH) {
       int m = lo + (hi - lo) / 2;
-      int k = slot(m)[0];
 
-      if      (key <= k) hi = m;
-      else if (key >  k) lo = m + 1;
+      if (searchKey <= data[m]) hi = m;
+      else                      lo = m + 1;
+    }
+
+    return scanKeys(searchKey, lo, hi);
+  }
+
+  int
+  BTrie::scanKeys(Key searchKey, int lo, int hi)
+  {
+    // Keys are sorted, so the keys less than the search key in each block form
+    // a prefix of it, whose length is given by the number of set bits in the
+    // comparison mask. 64-bit keys are only compared four at a time with AVX2,
+    // as SSE2 has no 64-bit comparison.
+#if defined(KEY64) && defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi64x(searchKey);
+    for (; lo + 4 <= hi; lo += 4) {
+      __m256i block = _mm256_loadu_si256((const __m256i *)&data[lo]);
+      __m256i less  = _mm256_cmpgt_epi64(needle, block);
+      int     mask  = _mm256_movemask_pd(_mm256_castsi256_pd(less));
+
+      if (mask != 0xF) return lo + __builtin_popcount(mask);
+    }
+#elif defined(KEY64)
+#elif defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi32(searchKey);
+    for (; lo + 8 <= hi; lo += 8) {
+      __m256i block = _mm256_loadu_si256((const __m256i *)&data[lo]);
+      __m256i less  = _mm256_cmpgt_epi32(needle, block);
+      int     mask  = _mm256_movemask_ps(_mm256_castsi256_ps(less));
+
+      if (mask != 0xFF) return lo + __builtin_popcount(mask);
     }
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi32(searchKey);
+    for (; lo + 4 <= hi; lo += 4) {
+      __m128i block = _mm_loadu_si128((const __m128i *)&data[lo]);
+      __m128i less  = _mm_cmpgt_epi32(needle, block);
+      int     mask  = _mm_movemask_ps(_mm_castsi128_ps(less));
+
+      if (mask != 0xF) return lo + __builtin_popcount(mask);
+    }
+#endif
+
+    while (lo < hi && data[lo] < searchKey)
+      lo++;
 
     return lo;
   }
@@ -705,13 +1281,7 @@ namespace DB {
   void
   BTrie::makeRoom(int index, int size)
   {
-    int stride = type == Leaf
-      ? l.stride
-      : BRANCH_STRIDE;
-
-    memmove(slot(index + size), slot(index),
-            (count - index) * stride * sizeof(int));
-
+    moveSlots(this, index + size, this, index, count - index);
     count += size;
   }
 }
@@ -2,31 +2,48 @@
 
 #include <limits>
 #include <stdexcept>
+#include <utility>
 
 #include "allocator.h"
 #include "db.h"
+#include "dim.h"
 
 namespace DB {
-  BTrieIterator::BTrieIterator(page_id rootPID, int fst, int snd)
-    : mFst       ( fst )
-    , mSnd       ( snd )
-    , mDummy     ( (BTrie *) BTrie::onHeap(2, 1) )
-    , mHistory   {}
+  BTrieIterator::BTrieIterator(page_id rootPID, const std::vector<int> &order,
+                               std::shared_ptr<const Snapshot> snapshot)
+    : mIsValid   ( order.back() + 1, false )
+    , mSnapshot  ( std::move(snapshot) )
+    , mRootPID   ( rootPID )
+    , mInline    ( BTrie::freeNode(mInlineBuf, 1, Dim::INLINE_SIZE) )
+    , mCopies    ( mSnapshot
+                   ? new char[order.size() * Dim::PAGE_SIZE]
+                   : nullptr )
+    , mPath      {}
     , mCurrDepth ( -1 )
     , mNodeDepth ( -1 )
     , mPID       ( INVALID_PAGE )
-    , mCurr      ( mDummy )
+    , mCurr      ( nullptr )
     , mPos       ( 0 )
+    , mBox       ( nullptr )
+    , mBoxKey    ( 0 )
+    , mBoxEnd    ( false )
   {
-    mDummy->slot(0)[1] = rootPID;
+    mPath.reserve(order.size());
+
+    for (int o : order)
+      mIsValid[o] = true;
   }
 
   BTrieIterator::~BTrieIterator()
   {
-    if (mPID != INVALID_PAGE)
-      Global::BUFMGR->unpin(mPID);
+    release();
 
-    delete[] (char *)mDummy;
+    if (!mSnapshot)
+      for (const auto &above : mPath)
+        if (above.pid != INVALID_PAGE)
+          Global::BUFMGR->unpin(above.pid);
+
+    delete[] mCopies;
   }
 
   void
@@ -40,25 +57,45 @@ namespace DB {
         mCurrDepth == mNodeDepth)
       return;
 
-    // Save position at current level
-    mHistory.emplace(std::make_tuple(mPID, mPos, mNodeDepth));
-
     // Find the leftmost child
-    int cid = mCurr->slot(mPos)[1];
-    if (mPID != INVALID_PAGE)
-      Global::BUFMGR->unpin(mPID);
+    page_id cid      = mCurr ? mCurr->val(mPos) : mRootPID;
+    bool    isInline = mCurr && mCurr->inlineCount(mPos) > 0;
 
-    mPos  = 0;
-    mPID  = cid;
-    mCurr = BTrie::load(mPID);
-    while (mCurr->getType() != Leaf) {
-      cid   = mCurr->slot(0)[-1];
-      Global::BUFMGR->unpin(mPID);
-      mPID  = cid;
-      mCurr = BTrie::load(mPID);
-    }
+    // Save position at current level, holding on to its leaf.
+    mPath.push_back({mPID, mCurr, mPos, mNodeDepth, cid});
 
     mNodeDepth = mCurrDepth;
+    mPos       = 0;
+
+    // Inline sub-indices are traversed from their unpacked copy.
+    if (isInline) {
+      mCurr->unpack(mPath.back().pos, mInline);
+
+      mPID  = INVALID_PAGE;
+      mCurr = mInline;
+      mBox  = nullptr;
+      return;
+    }
+
+    if (mSnapshot) {
+      page_id lid;
+      BTrie::find(cid, std::numeric_limits<Key>::min(), lid, mPos,
+                  mSnapshot.get());
+      hold(lid);
+    } else {
+      BTrie *node = BTrie::load(cid);
+      while (node->getType() == Branch) {
+        page_id child = node->val(-1);
+        Global::BUFMGR->unpin(cid);
+        cid  = child;
+        node = BTrie::load(cid);
+      }
+
+      hold(cid, node);
+    }
+
+    if (mBox)
+      mBoxEnd = !mBox->seek(std::numeric_limits<Key>::min(), mBoxKey);
   }
 
   void
@@ -68,20 +105,17 @@ namespace DB {
     if (mCurrDepth >= mNodeDepth)
       return;
 
-    // Recover old position from history and swap it in.
-    if (mPID != INVALID_PAGE)
-      Global::BUFMGR->unpin(mPID);
-
-    auto past  = mHistory.top();
-    mPID       = std::get<0>(past);
-    mPos       = std::get<1>(past);
-    mNodeDepth = std::get<2>(past);
+    // Go back to the leaf above, which is still held, so need not be read
+    // again.
+    release();
 
-    mCurr = mPID == INVALID_PAGE
-      ? mDummy
-      : BTrie::load(mPID);
+    const Ancestor &above = mPath.back();
+    mPID       = above.pid;
+    mCurr      = above.node;
+    mPos       = above.pos;
+    mNodeDepth = above.depth;
 
-    mHistory.pop();
+    mPath.pop_back();
   }
 
   void
@@ -89,6 +123,13 @@ namespace DB {
   {
     if (!atValidDepth() || atEnd()) return;
 
+    if (mBox) {
+      mBoxEnd =
+        mBoxKey == std::numeric_limits<Key>::max() ||
+        !mBox->seek(mBoxKey + 1, mBoxKey);
+      return;
+    }
+
     mPos++;
 
     if (mPos < mCurr->getCount()) return;
@@ -96,52 +137,75 @@ namespace DB {
     // Find next non-empty page (or the end).
     page_id nid = mCurr->getNext();
     if (nid != INVALID_PAGE) {
-      Global::BUFMGR->unpin(mPID);
-      mPos  = 0;
-      mPID  = nid;
-      mCurr = BTrie::load(mPID);
+      release();
+      mPos = 0;
+      hold(nid);
     }
   }
 
   void
-  BTrieIterator::seek(int searchKey)
+  BTrieIterator::seek(Key searchKey)
   {
     if (!atValidDepth() || atEnd()) return;
 
     searchKey   = std::max(searchKey, key());
 
-    auto past   = mHistory.top();
-    page_id pid = std::get<0>(past);
-    int     pos = std::get<1>(past);
+    if (mBox) {
+      mBoxEnd = !mBox->seek(searchKey, mBoxKey);
+      return;
+    }
 
-    page_id rootPID;
-    if (pid == INVALID_PAGE) {
-      rootPID = mDummy->slot(pos)[1];
-    } else {
-      rootPID = BTrie::load(pid)->slot(pos)[1];
-      Global::BUFMGR->unpin(pid);
+    // Seeks are usually short, so look for the key in the rest of the current
+    // leaf, and then in the next few leaves, before searching from the root of
+    // the sub-index.
+    for (int hop = 0; ; ++hop) {
+      int count = mCurr->getCount();
+      if (count > 0 && mCurr->key(count - 1) >= searchKey) {
+        mPos = mCurr->gallop(searchKey, mPos);
+        return;
+      }
+
+      page_id nid = mCurr->getNext();
+      if (nid == INVALID_PAGE) {
+        mPos = count;
+        return;
+      }
+
+      if (hop == Dim::SEEK_HOPS)
+        break;
+
+      release();
+      mPos = 0;
+      hold(nid);
     }
 
-    Global::BUFMGR->unpin(mPID);
-    BTrie::find(rootPID, searchKey, mPID, mPos);
-    mCurr = BTrie::load(mPID);
+    page_id rootPID = mPath.back().root;
+
+    release();
+
+    page_id lid;
+    BTrie::find(rootPID, searchKey, lid, mPos, mSnapshot.get());
+    hold(lid);
   }
 
-  int
+  Key
   BTrieIterator::key() const
   {
     if (!atValidDepth())
-      return std::numeric_limits<int>::min();
+      return std::numeric_limits<Key>::min();
 
     if (atEnd())
-      return std::numeric_limits<int>::max();
+      return std::numeric_limits<Key>::max();
 
-    return mCurr->slot(mPos)[0];
+    return mBox ? mBoxKey : mCurr->key(mPos);
   }
 
   bool
   BTrieIterator::atEnd() const
   {
+    if (mBox)
+      return atValidDepth() && mBoxEnd;
+
     return
       atValidDepth()            &&
       mPos >= mCurr->getCount() &&
@@ -152,7 +216,47 @@ namespace DB {
   BTrieIterator::atValidDepth() const
   {
     return
-      mCurrDepth == mFst ||
-      mCurrDepth == mSnd;
+      0 <= mCurrDepth                        &&
+      mCurrDepth < (int)mIsValid.size()      &&
+      mIsValid[mCurrDepth];
+  }
+
+  bool
+  BTrieIterator::bits(Bits &out) const
+  {
+    if (!atValidDepth() || !mBox || mBox->getType() != Bitmap)
+      return false;
+
+    out.words = mBox->getWords();
+    out.count = Container::WORDS;
+    out.base  = mBox->getBase();
+    return true;
+  }
+
+  void
+  BTrieIterator::hold(page_id pid, BTrie *leaf)
+  {
+    mPID = pid;
+
+    if (!mSnapshot) {
+      mCurr = leaf ? leaf : BTrie::load(pid);
+    } else {
+      char *copy = mCopies + (mPath.size() - 1) * Dim::PAGE_SIZE;
+      BTrie::copy(pid, mSnapshot.get(), (BTrie *)copy);
+      mCurr = (BTrie *)copy;
+    }
+
+    mBox = Container::isContainer(mCurr->getType())
+      ? (const Container *)mCurr
+      : nullptr;
+  }
+
+  void
+  BTrieIterator::release()
+  {
+    if (mPID != INVALID_PAGE && !mSnapshot)
+      Global::BUFMGR->unpin(mPID);
+
+    mBox = nullptr;
   }
 }
@@ -11,13 +11,45 @@ namespace DB {
     : mFrames(new Frame[poolSize])
     , mReplacer(mFrames, poolSize)
     , mPoolSize(poolSize)
-  {}
+  {
+    mFrameOf.reserve(poolSize);
+
+    // Empty frames are taken from the back, so the first is taken first.
+    for (int i = poolSize - 1; i >= 0; --i)
+      mEmpty.push_back(i);
+  }
 
   BufMgr::~BufMgr() { delete[] mFrames; }
 
   char *
   BufMgr::pin(page_id pid, bool isEmpty)
   {
+    return pinFrame(pid, isEmpty, false);
+  }
+
+  char *
+  BufMgr::pinForReader(page_id pid)
+  {
+    return pinFrame(pid, false, true);
+  }
+
+  void
+  BufMgr::unpin(page_id pid, bool dirty)
+  {
+    unpinFrame(pid, dirty, false);
+  }
+
+  void
+  BufMgr::unpinForReader(page_id pid)
+  {
+    unpinFrame(pid, false, true);
+  }
+
+  char *
+  BufMgr::pinFrame(page_id pid, bool isEmpty, bool reader)
+  {
+    std::lock_guard<std::recursive_mutex> guard(mLatch);
+
     if (pid == INVALID_PAGE)
       return nullptr;
 
@@ -28,20 +60,32 @@ namespace DB {
         throw std::runtime_error("No Free Frames!");
     }
 
+    // Every empty frame is offered by findFrame before the replacer is asked
+    // for a victim, so the frame is either the last empty one, or holds a page
+    // that must make way.
     Frame &frame = mFrames[fid];
     if (frame.getPageID() != pid) {
-      frame.evict();
+      if (frame.isEmpty()) {
+        mEmpty.pop_back();
+      } else {
+        mFrameOf.erase(frame.getPageID());
+        frame.evict();
+      }
+
       frame.setPage(pid, isEmpty);
+      mFrameOf[pid] = fid;
     }
 
-    frame.pin();
+    frame.pin(reader);
     mReplacer.framePinned(fid);
     return frame.getPage();
   }
 
   void
-  BufMgr::unpin(page_id pid, bool dirty)
+  BufMgr::unpinFrame(page_id pid, bool dirty, bool reader)
   {
+    std::lock_guard<std::recursive_mutex> guard(mLatch);
+
     if (pid == INVALID_PAGE)
       throw std::runtime_error("Invalid Page!");
 
@@ -53,14 +97,24 @@ namespace DB {
     if (frame.getPageID() != pid || !frame.isPinned())
       throw std::runtime_error("Page Not Pinned!");
 
+    if (reader && !frame.isReaderPinned())
+      throw std::runtime_error("Page Not Pinned By Reader!");
+
     if (dirty) frame.mark();
-    frame.unpin();
+    frame.unpin(reader);
     mReplacer.frameUnpinned(fid);
+
+    if (!frame.isPinned() && mDoomed.erase(pid) > 0) {
+      emptyFrame(fid, false);
+      Global::ALLOC->pfree(pid);
+    }
   }
 
   page_id
   BufMgr::bnew(char *&first, int howMany)
   {
+    std::lock_guard<std::recursive_mutex> guard(mLatch);
+
     page_id pid0 = Global::ALLOC->palloc(howMany);
 
     first = pin(pid0, true);
@@ -72,9 +126,30 @@ namespace DB {
     return pid0;
   }
 
+  page_id
+  BufMgr::bnewBetween(char *&page, page_id from, page_id to)
+  {
+    std::lock_guard<std::recursive_mutex> guard(mLatch);
+
+    page = nullptr;
+    page_id pid = Global::ALLOC->pallocBetween(from, to);
+    if (pid == INVALID_PAGE)
+      return INVALID_PAGE;
+
+    page = pin(pid, true);
+    if (page == nullptr) {
+      Global::ALLOC->pfree(pid);
+      return INVALID_PAGE;
+    }
+
+    return pid;
+  }
+
   void
   BufMgr::bfree(page_id pid)
   {
+    std::lock_guard<std::recursive_mutex> guard(mLatch);
+
     if (pid == INVALID_PAGE) return;
 
     int fid = findFrame(pid);
@@ -89,19 +164,26 @@ namespace DB {
       return;
     }
 
-    frame.unpin();
+    // Snapshot readers may still hold the page, having found it before the
+    // writer replaced it. They are left to let go of it, but any other pin
+    // means the page is still in use.
     if (frame.isPinned()) {
-      frame.pin();
-      throw std::runtime_error("Attempted to free pinned page!");
+      if (!frame.isPinnedByReadersOnly())
+        throw std::runtime_error("Attempted to free pinned page!");
+
+      mDoomed.insert(pid);
+      return;
     }
 
-    frame.free();
+    emptyFrame(fid, false);
     Global::ALLOC->pfree(pid);
   }
 
   void
   BufMgr::flush(page_id pid)
   {
+    std::lock_guard<std::recursive_mutex> guard(mLatch);
+
     if (pid == INVALID_PAGE)
       throw std::runtime_error("Flushing invalid page");
 
@@ -116,22 +198,28 @@ namespace DB {
     if (frame.isPinned())
       throw std::runtime_error("Flushing pinned page");
 
-    frame.evict();
+    emptyFrame(fid, true);
   }
 
   int
   BufMgr::findFrame(page_id pid)
   {
-    int lastEmpty = INVALID_FRAME;
-
-    for (int i = 0; i < mPoolSize; ++i) {
-      Frame &frame = mFrames[i];
-      if (frame.isEmpty())
-        lastEmpty = i;
-      else if (frame.getPageID() == pid)
-        return i;
-    }
+    auto it = mFrameOf.find(pid);
+    if (it != mFrameOf.end())
+      return it->second;
+
+    return mEmpty.empty() ? INVALID_FRAME : mEmpty.back();
+  }
+
+  void
+  BufMgr::emptyFrame(int fid, bool writeBack)
+  {
+    Frame &frame = mFrames[fid];
+    mFrameOf.erase(frame.getPageID());
+
+    if (writeBack) frame.evict();
+    else           frame.free();
 
-    return lastEmpty;
+    mEmpty.push_back(fid);
   }
 }
@@ -0,0 +1,299 @@
+#include "container.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "btrie.h"
+#include "db.h"
+#include "dim.h"
+
+namespace DB {
+
+  const int Container::SPACE     =
+    (Dim::PAGE_SIZE - offsetof(Container, data)) / sizeof(Key);
+  const int Container::WORDS     = SPACE * sizeof(Key) / sizeof(uint64_t);
+  const int Container::BITS      = WORDS * 64;
+  const int Container::MAX_RUNS  = SPACE / 2;
+  const int Container::MIN_COUNT = SPACE / 4;
+
+  bool
+  Container::isContainer(NodeType type)
+  {
+    return type == Bitmap || type == Runs;
+  }
+
+  page_id
+  Container::build(const std::vector<Key> &keys)
+  {
+    if (keys.empty())
+      return INVALID_PAGE;
+
+    // Bitmaps start at the multiple of 64 at or below their smallest key, but
+    // no later than the last span that ends within the range of keys, so that
+    // the value of every bit is a key.
+    Key lo = keys.front() - ((keys.front() % 64) + 64) % 64;
+    lo = std::min(lo, (Key)(std::numeric_limits<Key>::max() - (BITS - 1)));
+
+    uint64_t span = (uint64_t)keys.back() - lo + 1;
+
+    int runs = 1;
+    for (std::size_t i = 1; i < keys.size(); ++i)
+      if (keys[i] - 1 != keys[i - 1])
+        runs++;
+
+    NodeType type;
+    if      (span <= (uint64_t)BITS) type = Bitmap;
+    else if (runs <= MAX_RUNS)       type = Runs;
+    else                             return INVALID_PAGE;
+
+    char *page;
+    page_id pid = Global::BUFMGR->bnew(page);
+    Container *box = (Container *)page;
+
+    box->type    = type;
+    box->count   = keys.size();
+    box->version = 0;
+    box->base    = lo;
+    box->runs    = 0;
+
+    switch (type) {
+    case Bitmap:
+      memset(box->data, 0, WORDS * sizeof(uint64_t));
+      for (Key key : keys) {
+        uint64_t off = (uint64_t)key - lo;
+        box->words()[off / 64] |= uint64_t(1) << (off % 64);
+      }
+      break;
+    case Runs:
+      for (std::size_t i = 0; i < keys.size(); ++i) {
+        if (i == 0 || keys[i] - 1 != keys[i - 1])
+          box->first(box->runs++) = keys[i];
+
+        box->last(box->runs - 1) = keys[i];
+      }
+      break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
+
+    Global::BUFMGR->unpin(pid, true);
+    return pid;
+  }
+
+  Container *
+  Container::load(page_id pid)
+  {
+    return (Container *)BTrie::load(pid);
+  }
+
+  bool
+  Container::insert(Key key, bool &didChange)
+  {
+    didChange = false;
+
+    switch (type) {
+    case Bitmap: {
+      if (key < base || (uint64_t)key - base >= (uint64_t)BITS)
+        return false;
+
+      uint64_t  off  = (uint64_t)key - base;
+      uint64_t &word = words()[off / 64];
+      uint64_t  bit  = uint64_t(1) << (off % 64);
+      if (word & bit)
+        return true;
+
+      word |= bit;
+      break;
+    }
+    case Runs: {
+      int i = findRun(key);
+      if (i < runs && first(i) <= key)
+        return true;
+
+      // The key may extend the runs either side of it, and join them. It lies
+      // strictly between them, so stepping from it by one cannot overflow.
+      bool joinsPrev = i > 0    && last(i - 1) == key - 1;
+      bool joinsNext = i < runs && first(i)    == key + 1;
+
+      if (joinsPrev && joinsNext) {
+        last(i - 1) = last(i);
+        makeRoom(i + 1, -1);
+      } else if (joinsPrev) {
+        last(i - 1) = key;
+      } else if (joinsNext) {
+        first(i) = key;
+      } else if (runs < MAX_RUNS) {
+        makeRoom(i, 1);
+        first(i) = last(i) = key;
+      } else {
+        return false;
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
+
+    count++;
+    didChange = true;
+    return true;
+  }
+
+  bool
+  Container::remove(Key key, bool &didChange)
+  {
+    didChange = false;
+
+    switch (type) {
+    case Bitmap: {
+      if (key < base || (uint64_t)key - base >= (uint64_t)BITS)
+        return true;
+
+      uint64_t  off  = (uint64_t)key - base;
+      uint64_t &word = words()[off / 64];
+      uint64_t  bit  = uint64_t(1) << (off % 64);
+      if (!(word & bit))
+        return true;
+
+      word &= ~bit;
+      break;
+    }
+    case Runs: {
+      int i = findRun(key);
+      if (i == runs || key < first(i))
+        return true;
+
+      if (first(i) == last(i)) {
+        makeRoom(i + 1, -1);
+      } else if (key == first(i)) {
+        first(i)++;
+      } else if (key == last(i)) {
+        last(i)--;
+      } else if (runs < MAX_RUNS) {
+        // Split the run around the key.
+        makeRoom(i + 1, 1);
+        first(i + 1) = key + 1;
+        last(i + 1)  = last(i);
+        last(i)      = key - 1;
+      } else {
+        return false;
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
+
+    count--;
+    didChange = true;
+    return true;
+  }
+
+  bool
+  Container::seek(Key key, Key &found) const
+  {
+    switch (type) {
+    case Bitmap: {
+      uint64_t off = key <= base ? 0 : (uint64_t)key - base;
+      if (off >= (uint64_t)BITS)
+        return false;
+
+      const uint64_t *ws   = getWords();
+      int             w    = off / 64;
+      uint64_t        word = ws[w] & (~uint64_t(0) << (off % 64));
+
+      while (word == 0) {
+        if (++w == WORDS)
+          return false;
+
+        word = ws[w];
+      }
+
+      found = base + 64 * w + __builtin_ctzll(word);
+      return true;
+    }
+    case Runs: {
+      int i = findRun(key);
+      if (i == runs)
+        return false;
+
+      found = std::max(key, first(i));
+      return true;
+    }
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
+  }
+
+  void
+  Container::keys(std::vector<Key> &out) const
+  {
+    out.reserve(out.size() + count);
+
+    switch (type) {
+    case Bitmap: {
+      const uint64_t *ws = getWords();
+      for (int w = 0; w < WORDS; ++w)
+        for (uint64_t word = ws[w]; word; word &= word - 1)
+          out.push_back(base + 64 * w + __builtin_ctzll(word));
+      break;
+    }
+    case Runs:
+      for (int i = 0; i < runs; ++i)
+        for (uint64_t n = 0; n <= (uint64_t)last(i) - first(i); ++n)
+          out.push_back(first(i) + n);
+      break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
+    }
+  }
+
+  NodeType
+  Container::getType() const
+  {
+    return type;
+  }
+
+  int
+  Container::getCount() const
+  {
+    return count;
+  }
+
+  Key
+  Container::getBase() const
+  {
+    return base;
+  }
+
+  const uint64_t *
+  Container::getWords() const
+  {
+    return (const uint64_t *)data;
+  }
+
+  int
+  Container::findRun(Key key) const
+  {
+    int lo = 0, hi = runs;
+    while (lo < hi) {
+      int m = lo + (hi - lo) / 2;
+
+      if (last(m) < key) lo = m + 1;
+      else               hi = m;
+    }
+
+    return lo;
+  }
+
+  void
+  Container::makeRoom(int index, int size)
+  {
+    memmove(&first(index + size), &first(index),
+            2 * (runs - index) * sizeof(Key));
+    runs += size;
+  }
+}
@@ -0,0 +1,222 @@
+#include "csr_iterator.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace DB {
+  CSRIterator::CSRIterator(const CSRTrie &trie, const std::vector<int> &order)
+    : mTrie      ( trie )
+    , mIsValid   ( order.back() + 1, false )
+    , mCurrDepth ( -1 )
+    , mLevel     ( -1 )
+    , mBasePos   ( trie.getWidth() )
+    , mBaseEnd   ( trie.getWidth() )
+    , mInsPos    ( trie.getWidth() )
+    , mInsEnd    ( trie.getWidth() )
+    , mDelPos    ( trie.getWidth() )
+    , mDelEnd    ( trie.getWidth() )
+  {
+    for (int o : order)
+      mIsValid[o] = true;
+  }
+
+  void
+  CSRIterator::open()
+  {
+    if (atEnd()) throw std::runtime_error("open: iterator finished!");
+
+    mCurrDepth++;
+    if (!atValidDepth())
+      return;
+
+    const int l = mLevel;
+    const int n = mLevel + 1;
+
+    // The root spans everything.
+    if (l < 0) {
+      mLevel      = n;
+      mBasePos[n] = 0; mBaseEnd[n] = mTrie.keys(0).size();
+      mInsPos[n]  = 0; mInsEnd[n]  = mTrie.inserted().size();
+      mDelPos[n]  = 0; mDelEnd[n]  = mTrie.deleted().size();
+      skipRemoved();
+      return;
+    }
+
+    // Find the ranges for the children of the current key, before moving down.
+    const auto &ins = mTrie.inserted();
+    const auto &del = mTrie.deleted();
+
+    const Key  k      = std::min(baseKey(), insKey());
+    const bool inBase = baseKey() == k;
+    const bool inIns  = insKey()  == k;
+
+    int delPos = lowerBound(del, mDelPos[l], mDelEnd[l], k);
+    int delEnd = upperBound(del, delPos,     mDelEnd[l], k);
+    int insEnd = inIns ? upperBound(ins, mInsPos[l], mInsEnd[l], k) : 0;
+
+    mLevel = n;
+    if (inBase) {
+      const auto &offsets = mTrie.offsets(l);
+      mBasePos[n] = offsets[mBasePos[l]];
+      mBaseEnd[n] = offsets[mBasePos[l] + 1];
+    } else {
+      mBasePos[n] = mBaseEnd[n] = 0;
+    }
+
+    if (inIns) {
+      mInsPos[n] = mInsPos[l];
+      mInsEnd[n] = insEnd;
+    } else {
+      mInsPos[n] = mInsEnd[n] = 0;
+    }
+
+    mDelPos[n] = delPos;
+    mDelEnd[n] = delEnd;
+    skipRemoved();
+  }
+
+  void
+  CSRIterator::up()
+  {
+    if (atValidDepth())
+      mLevel--;
+
+    mCurrDepth--;
+  }
+
+  void
+  CSRIterator::next()
+  {
+    if (!atValidDepth() || atEnd()) return;
+
+    const Key k = key();
+
+    if (baseKey() == k) {
+      mBasePos[mLevel]++;
+      skipRemoved();
+    }
+
+    if (insKey() == k)
+      mInsPos[mLevel] = upperBound(mTrie.inserted(),
+                                   mInsPos[mLevel], mInsEnd[mLevel], k);
+  }
+
+  void
+  CSRIterator::seek(Key searchKey)
+  {
+    if (!atValidDepth() || atEnd()) return;
+
+    const auto &keys = mTrie.keys(mLevel);
+    int &pos = mBasePos[mLevel];
+    int  end = mBaseEnd[mLevel];
+
+    // Gallop forwards until the search key is overtaken, then binary search
+    // the last step.
+    if (pos < end && keys[pos] < searchKey) {
+      int lo = pos, step = 1;
+      while (lo + step < end && keys[lo + step] < searchKey) {
+        lo   += step;
+        step <<= 1;
+      }
+
+      int hi = std::min(lo + step, end);
+      pos = std::lower_bound(keys.begin() + lo + 1,
+                             keys.begin() + hi,
+                             searchKey) - keys.begin();
+      skipRemoved();
+    }
+
+    mInsPos[mLevel] = lowerBound(mTrie.inserted(),
+                                 mInsPos[mLevel], mInsEnd[mLevel], searchKey);
+  }
+
+  Key
+  CSRIterator::key() const
+  {
+    if (!atValidDepth())
+      return std::numeric_limits<Key>::min();
+
+    return std::min(baseKey(), insKey());
+  }
+
+  bool
+  CSRIterator::atEnd() const
+  {
+    return
+      atValidDepth()                        &&
+      mBasePos[mLevel] >= mBaseEnd[mLevel]  &&
+      mInsPos[mLevel]  >= mInsEnd[mLevel];
+  }
+
+  bool
+  CSRIterator::atValidDepth() const
+  {
+    return
+      0 <= mCurrDepth                        &&
+      mCurrDepth < (int)mIsValid.size()      &&
+      mIsValid[mCurrDepth];
+  }
+
+  Key
+  CSRIterator::baseKey() const
+  {
+    return mBasePos[mLevel] < mBaseEnd[mLevel]
+      ? mTrie.keys(mLevel)[mBasePos[mLevel]]
+      : std::numeric_limits<Key>::max();
+  }
+
+  Key
+  CSRIterator::insKey() const
+  {
+    return mInsPos[mLevel] < mInsEnd[mLevel]
+      ? mTrie.inserted()[mInsPos[mLevel]][mLevel]
+      : std::numeric_limits<Key>::max();
+  }
+
+  void
+  CSRIterator::skipRemoved()
+  {
+    const auto &del  = mTrie.deleted();
+    const auto &keys = mTrie.keys(mLevel);
+
+    int &pos = mBasePos[mLevel];
+    int  end = mBaseEnd[mLevel];
+
+    while (pos < end && mDelPos[mLevel] < mDelEnd[mLevel]) {
+      Key k    = keys[pos];
+      int from = lowerBound(del, mDelPos[mLevel], mDelEnd[mLevel], k);
+      int to   = upperBound(del, from,            mDelEnd[mLevel], k);
+
+      // Removed records are always in the arrays, so if as many have been
+      // removed as there were, there are none left.
+      if (to - from < mTrie.leafCount(mLevel, pos))
+        break;
+
+      mDelPos[mLevel] = to;
+      pos++;
+    }
+  }
+
+  int
+  CSRIterator::upperBound(const std::vector<CSRTrie::Record> &recs,
+                          int from, int to, Key key) const
+  {
+    const int l = mLevel;
+    return std::upper_bound(recs.begin() + from, recs.begin() + to, key,
+                            [l](Key k, const CSRTrie::Record &r) {
+                              return k < r[l];
+                            }) - recs.begin();
+  }
+
+  int
+  CSRIterator::lowerBound(const std::vector<CSRTrie::Record> &recs,
+                          int from, int to, Key key) const
+  {
+    const int l = mLevel;
+    return std::lower_bound(recs.begin() + from, recs.begin() + to, key,
+                            [l](const CSRTrie::Record &r, Key k) {
+                              return r[l] < k;
+                            }) - recs.begin();
+  }
+}
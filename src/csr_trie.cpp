@@ -0,0 +1,306 @@
+#include "csr_trie.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dim.h"
+
+namespace DB {
+  CSRTrie::CSRTrie(int width)
+    : mWidth   ( width )
+    , mKeys    ( width )
+    , mOffsets ( width - 1 )
+  {
+    build({});
+  }
+
+  bool
+  CSRTrie::insert(const Record &rec)
+  {
+    // Re-inserting a removed record just revives it.
+    if (inBase(rec)) {
+      auto it = std::lower_bound(mDeleted.begin(), mDeleted.end(), rec);
+      if (it == mDeleted.end() || *it != rec)
+        return false;
+
+      mDeleted.erase(it);
+      return true;
+    }
+
+    auto it = std::lower_bound(mInserted.begin(), mInserted.end(), rec);
+    if (it != mInserted.end() && *it == rec)
+      return false;
+
+    mInserted.insert(it, rec);
+    compactIfFull();
+    return true;
+  }
+
+  void
+  CSRTrie::insertBatch(const std::vector<Key> &recs, std::vector<Key> &added)
+  {
+    std::vector<Key> old = records();
+
+    std::vector<Key> merged;
+    merged.reserve(old.size() + recs.size());
+
+    auto less = [this](const Key *a, const Key *b) {
+      return std::lexicographical_compare(a, a + mWidth, b, b + mWidth);
+    };
+
+    size_t o = 0, r = 0;
+    while (r < recs.size()) {
+      const Key *rec = &recs[r];
+      if (o < old.size() && less(&old[o], rec)) {
+        merged.insert(merged.end(), &old[o], &old[o] + mWidth);
+        o += mWidth;
+        continue;
+      }
+
+      if (o == old.size() || less(rec, &old[o]))
+        added.insert(added.end(), rec, rec + mWidth);
+      else
+        o += mWidth;
+
+      merged.insert(merged.end(), rec, rec + mWidth);
+      r += mWidth;
+    }
+
+    merged.insert(merged.end(), old.begin() + o, old.end());
+    build(merged);
+  }
+
+  bool
+  CSRTrie::remove(const Record &rec)
+  {
+    auto it = std::lower_bound(mInserted.begin(), mInserted.end(), rec);
+    if (it != mInserted.end() && *it == rec) {
+      mInserted.erase(it);
+      return true;
+    }
+
+    if (!inBase(rec))
+      return false;
+
+    auto jt = std::lower_bound(mDeleted.begin(), mDeleted.end(), rec);
+    if (jt != mDeleted.end() && *jt == rec)
+      return false;
+
+    mDeleted.insert(jt, rec);
+    compactIfFull();
+    return true;
+  }
+
+  int
+  CSRTrie::removeRange(int level, Key lo, Key hi)
+  {
+    if (level > 0) {
+      std::vector<Key> recs = records();
+      std::vector<Key> kept;
+      kept.reserve(recs.size());
+
+      for (size_t r = 0; r < recs.size(); r += mWidth)
+        if (recs[r + level] < lo || hi < recs[r + level])
+          kept.insert(kept.end(), &recs[r], &recs[r] + mWidth);
+
+      build(kept);
+      return (recs.size() - kept.size()) / mWidth;
+    }
+
+    // Records are sorted by their first key, so those in range are a run of
+    // the delta, and of the tombstones.
+    auto erase = [=](std::vector<Record> &recs) {
+      auto below = [=](const Record &rec) { return rec[0] < lo; };
+      auto upTo  = [=](const Record &rec) { return rec[0] <= hi; };
+
+      auto first = std::partition_point(recs.begin(), recs.end(), below);
+      auto last  = std::partition_point(first, recs.end(), upTo);
+
+      int count = last - first;
+      recs.erase(first, last);
+      return count;
+    };
+
+    int removed = erase(mInserted) - erase(mDeleted);
+
+    // The keys in range at the first level own a span of the keys at every
+    // level below, bounded by their offsets.
+    const auto &top = mKeys[0];
+    int begin = std::lower_bound(top.begin(), top.end(), lo) - top.begin();
+    int end   = std::upper_bound(top.begin(), top.end(), hi) - top.begin();
+
+    for (int l = 0; l < mWidth; ++l) {
+      auto &keys = mKeys[l];
+      keys.erase(keys.begin() + begin, keys.begin() + end);
+
+      if (l == mWidth - 1) {
+        removed += end - begin;
+        break;
+      }
+
+      auto &offsets = mOffsets[l];
+      int childBegin = offsets[begin];
+      int childEnd   = offsets[end];
+
+      offsets.erase(offsets.begin() + begin, offsets.begin() + end);
+      for (size_t i = begin; i < offsets.size(); ++i)
+        offsets[i] -= childEnd - childBegin;
+
+      begin = childBegin;
+      end   = childEnd;
+    }
+
+    return removed;
+  }
+
+  std::vector<Key>
+  CSRTrie::records() const
+  {
+    const int leaves = mKeys[mWidth - 1].size();
+
+    std::vector<Key> recs;
+    recs.reserve((leaves + mInserted.size()) * mWidth);
+
+    auto less = [this](const Key *a, const Key *b) {
+      return std::lexicographical_compare(a, a + mWidth, b, b + mWidth);
+    };
+
+    auto emit = [this, &recs](const Key *rec) {
+      recs.insert(recs.end(), rec, rec + mWidth);
+    };
+
+    // Walk the leaves in order, moving each of their ancestors along with
+    // them, and merge in the delta, whilst dropping tombstones.
+    Record rec(mWidth);
+    std::vector<int> pos(mWidth, 0);
+    auto ins = mInserted.begin();
+    auto del = mDeleted.begin();
+    for (int leaf = 0; leaf < leaves; ++leaf) {
+      pos[mWidth - 1] = leaf;
+      for (int l = mWidth - 2; l >= 0; --l)
+        while (mOffsets[l][pos[l] + 1] <= pos[l + 1])
+          pos[l]++;
+
+      for (int l = 0; l < mWidth; ++l)
+        rec[l] = mKeys[l][pos[l]];
+
+      for (; ins != mInserted.end() && less(ins->data(), rec.data()); ++ins)
+        emit(ins->data());
+
+      if (del != mDeleted.end() && *del == rec)
+        ++del;
+      else
+        emit(rec.data());
+    }
+
+    for (; ins != mInserted.end(); ++ins)
+      emit(ins->data());
+
+    return recs;
+  }
+
+  int
+  CSRTrie::getWidth() const
+  {
+    return mWidth;
+  }
+
+  const std::vector<Key> &
+  CSRTrie::keys(int level) const
+  {
+    return mKeys[level];
+  }
+
+  const std::vector<int> &
+  CSRTrie::offsets(int level) const
+  {
+    return mOffsets[level];
+  }
+
+  const std::vector<CSRTrie::Record> &
+  CSRTrie::inserted() const
+  {
+    return mInserted;
+  }
+
+  const std::vector<CSRTrie::Record> &
+  CSRTrie::deleted() const
+  {
+    return mDeleted;
+  }
+
+  int
+  CSRTrie::leafCount(int level, int pos) const
+  {
+    int lo = pos, hi = pos + 1;
+    for (int l = level; l < mWidth - 1; ++l) {
+      lo = mOffsets[l][lo];
+      hi = mOffsets[l][hi];
+    }
+
+    return hi - lo;
+  }
+
+  bool
+  CSRTrie::inBase(const Record &rec) const
+  {
+    int lo = 0, hi = mKeys[0].size();
+    for (int l = 0; l < mWidth; ++l) {
+      const auto &keys = mKeys[l];
+
+      auto it = std::lower_bound(keys.begin() + lo, keys.begin() + hi, rec[l]);
+      if (it == keys.begin() + hi || *it != rec[l])
+        return false;
+
+      if (l < mWidth - 1) {
+        int pos = it - keys.begin();
+        lo = mOffsets[l][pos];
+        hi = mOffsets[l][pos + 1];
+      }
+    }
+
+    return true;
+  }
+
+  void
+  CSRTrie::compactIfFull()
+  {
+    size_t base  = mKeys[mWidth - 1].size();
+    size_t limit = std::max<size_t>(Dim::DELTA_SIZE, std::sqrt(base));
+
+    if (mInserted.size() + mDeleted.size() >= limit)
+      build(records());
+  }
+
+  void
+  CSRTrie::build(const std::vector<Key> &recs)
+  {
+    for (auto &keys : mKeys)
+      keys.clear();
+
+    for (auto &offsets : mOffsets)
+      offsets.clear();
+
+    for (size_t r = 0; r < recs.size(); r += mWidth) {
+      // New nodes start from the first level at which the record differs from
+      // the one before it.
+      int d = 0;
+      if (r > 0)
+        while (d < mWidth && recs[r + d] == recs[r - mWidth + d])
+          d++;
+
+      for (int l = d; l < mWidth; ++l) {
+        if (l < mWidth - 1)
+          mOffsets[l].push_back(mKeys[l + 1].size());
+
+        mKeys[l].push_back(recs[r + l]);
+      }
+    }
+
+    for (int l = 0; l < mWidth - 1; ++l)
+      mOffsets[l].push_back(mKeys[l + 1].size());
+
+    mInserted.clear();
+    mDeleted.clear();
+  }
+}
@@ -0,0 +1,104 @@
+#include "dictionary.h"
+
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace DB {
+  Dictionary::Dictionary(const char *fname)
+  {
+    std::ifstream in(fname);
+
+    std::string str;
+    while (std::getline(in, str)) {
+      mCodes.emplace(str, mStrings.size());
+      mStrings.push_back(str);
+    }
+
+    mFile.open(fname, std::ios::app);
+    if (!mFile)
+      throw std::runtime_error("Dictionary: cannot open file!");
+  }
+
+  Key
+  Dictionary::encode(const std::string &str)
+  {
+    auto it = mCodes.find(str);
+    if (it != mCodes.end())
+      return it->second;
+
+    if (mStrings.size() > (size_t)std::numeric_limits<Key>::max())
+      throw std::runtime_error("encode: dictionary is full!");
+
+    Key code = mStrings.size();
+    mCodes.emplace(str, code);
+    mStrings.push_back(str);
+
+    mFile << str << '\n';
+    return code;
+  }
+
+  bool
+  Dictionary::encodeFields(const std::string &line, int width,
+                           std::vector<Key> &out)
+  {
+    static const char *SPACE = " \t\r";
+
+    out.clear();
+
+    // Split the line before encoding any of it, so that the strings of lines
+    // that turn out not to be records are never added to the dictionary.
+    std::vector<std::string> strs;
+    std::istringstream fields(line);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+      size_t from = field.find_first_not_of(SPACE);
+      size_t to   = field.find_last_not_of(SPACE);
+
+      strs.push_back(from == std::string::npos
+                     ? std::string()
+                     : field.substr(from, to - from + 1));
+    }
+
+    if ((int)strs.size() != width)
+      return false;
+
+    for (const auto &str : strs)
+      out.push_back(encode(str));
+
+    return true;
+  }
+
+  bool
+  Dictionary::lookup(const std::string &str, Key &code) const
+  {
+    auto it = mCodes.find(str);
+    if (it == mCodes.end())
+      return false;
+
+    code = it->second;
+    return true;
+  }
+
+  const std::string &
+  Dictionary::decode(Key code) const
+  {
+    if (code < 0 || (size_t)code >= mStrings.size())
+      throw std::runtime_error("decode: unknown code!");
+
+    return mStrings[code];
+  }
+
+  void
+  Dictionary::write(std::ostream &out, const Key *rec, int width) const
+  {
+    for (int i = 0; i < width; ++i)
+      out << (i == 0 ? "" : ",") << decode(rec[i]);
+  }
+
+  int
+  Dictionary::size() const
+  {
+    return mStrings.size();
+  }
+}
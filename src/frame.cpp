@@ -10,14 +10,23 @@ namespace DB {
   Frame::Frame()
     : mPID(INVALID_PAGE)
     , mPinCount(0)
+    , mReaderPins(0)
     , mDirty(false)
   {}
 
   Frame::~Frame()              { evict(); }
 
-  void Frame::pin()            { mPinCount++; }
-  void Frame::unpin()          { mPinCount--; }
-  bool Frame::isPinned() const { return mPinCount > 0; }
+  void Frame::pin(bool reader)   { mPinCount++; mReaderPins += reader; }
+  void Frame::unpin(bool reader) { mPinCount--; mReaderPins -= reader; }
+
+  bool Frame::isPinned() const       { return mPinCount > 0; }
+  bool Frame::isReaderPinned() const { return mReaderPins > 0; }
+
+  bool
+  Frame::isPinnedByReadersOnly() const
+  {
+    return mPinCount > 0 && mPinCount == mReaderPins;
+  }
 
   void
   Frame::setPage(page_id pid, bool isEmpty)
@@ -48,9 +57,10 @@ namespace DB {
   void
   Frame::free()
   {
-    mPID      = INVALID_PAGE;
-    mPinCount = 0;
-    mDirty    = false;
+    mPID        = INVALID_PAGE;
+    mPinCount   = 0;
+    mReaderPins = 0;
+    mDirty      = false;
   }
 
   bool Frame::isEmpty() const { return mPID == INVALID_PAGE; }
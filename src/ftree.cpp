@@ -1,5 +1,6 @@
 #include "ftree.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstring>
@@ -12,7 +13,7 @@
 
 namespace DB {
   const int FTree::SPACE  =
-    (Dim::PAGE_SIZE - offsetof(FTree, data)) / sizeof(int);
+    (Dim::PAGE_SIZE - offsetof(FTree, data)) / sizeof(Key);
 
   const int FTree::SLOT_SPACE =
     static_cast<int>(std::sqrt(SPACE));
@@ -21,7 +22,7 @@ namespace DB {
     SPACE - SLOT_SPACE;
 
   const int FTree::TXN_HEADER_SIZE =
-    offsetof(Transaction, data) / sizeof(int);
+    offsetof(Transaction, data) / sizeof(Key);
 
   page_id
   FTree::leaf(int width)
@@ -41,7 +42,7 @@ namespace DB {
   }
 
   page_id
-  FTree::branch(int width, page_id leftPID, std::vector<int> slots)
+  FTree::branch(int width, page_id leftPID, std::vector<Key> slots)
   {
     if (slots.empty())
       return leftPID;
@@ -64,7 +65,7 @@ namespace DB {
       return branch;
     };
 
-    std::vector<int> spillOver;
+    std::vector<Key> spillOver;
     page_id bid;
     auto branch = freshBranch(bid, leftPID);
 
@@ -89,7 +90,7 @@ namespace DB {
       } else {
         // Copy Partitioning Key
         memmove(branch->slot(branch->count), &*it,
-                width * sizeof(int));
+                width * sizeof(Key));
 
         // Copy child PID
         branch->slot(branch->count)[width] = child;
@@ -108,7 +109,7 @@ namespace DB {
   }
 
   FTree::Diff
-  FTree::flush(page_id nid, Family family, int *txns)
+  FTree::flush(page_id nid, Family family, Key *txns)
   {
     Diff diff {.prop = PROP_NOTHING };
 
@@ -124,7 +125,7 @@ namespace DB {
     const auto  NT  = node->type;       // Node Type
 
     // Set up a place for splits to be recorded.
-    const NewSlots newNbrs = new std::vector<int>();
+    const NewSlots newNbrs = new std::vector<Key>();
 
     // When dealing with transactions, we may need to load one of these new
     // pages, so we keep track of that index, and the position within the pinned
@@ -133,7 +134,7 @@ namespace DB {
     int pos = -1;
 
     // A function which searches for the key in the available nodes.
-    auto seekKey = [nid, SS, &pid, &node, &newNbrs, &nbr, &pos](int *key) {
+    auto seekKey = [nid, SS, &pid, &node, &newNbrs, &nbr, &pos](Key *key) {
       // Find the appropriate node to search in.
       nbr = node->findNewSlot(newNbrs, key);
 
@@ -155,7 +156,7 @@ namespace DB {
       // transactions.
       while (t < TC) {
         auto txn = (Transaction *)&txns[TS * t + 1];
-        int *key = txn->data;
+        Key *key = txn->data;
         seekKey(key);
 
         switch (txn->message) {
@@ -166,17 +167,22 @@ namespace DB {
             break;
 
           if (node->isFull()) {
-            // We must split and try again.
+            // We must split and try again. Records arriving past the end of
+            // the tree leave the node full, as more are expected to follow.
+            int fill = pos == node->count && node->next == INVALID_PAGE
+              ? Dim::APPEND_FILL
+              : 50;
+
             int nextNbr = nbr * SS;
             newNbrs->insert(std::next(newNbrs->begin(), nextNbr), SS, 0);
-            page_id newNbr = node->split(pid, &(*newNbrs)[nextNbr]);
+            page_id newNbr = node->split(pid, &(*newNbrs)[nextNbr], fill);
             (*newNbrs)[nextNbr + W] = newNbr;
             continue;
           }
 
           // Perform the insertion.
           node->makeRoom(pos, 1);
-          memmove(node->slot(pos), key, W * sizeof(int));
+          memmove(node->slot(pos), key, W * sizeof(Key));
           break;
 
         case Delete:
@@ -196,7 +202,7 @@ namespace DB {
     case Branch:
       while (t < TC) {
         auto txn = (Transaction *)&txns[TS * t + 1];
-        int *key = txn->data;
+        Key *key = txn->data;
         seekKey(key);
 
         // Find all the transactions being sent to this child.
@@ -204,8 +210,8 @@ namespace DB {
         if (pos == node->count) {
           u = TC;
         } else {
-          int *pivot = new int[W];
-          memmove(pivot, node->slot(pos), W * sizeof(int));
+          Key *pivot = new Key[W];
+          memmove(pivot, node->slot(pos), W * sizeof(Key));
           pivot[W - 1]++;
 
           u = findTxn(txns, W, t, pivot);
@@ -213,13 +219,13 @@ namespace DB {
         }
 
         // Merge the new and existing transactions.
-        int *mergedTxns =
+        Key *mergedTxns =
           mergeTxns(node->txns(pos), &txns[TS * t + 1], u - t, W);
 
         // Just put them back into the buffer, if we can.
         if (mergedTxns[0] <= node->txnsPerChild()) {
           memmove(node->txns(pos), mergedTxns,
-                  (1 + mergedTxns[0] * node->txnSize()) * sizeof(int));
+                  (1 + mergedTxns[0] * node->txnSize()) * sizeof(Key));
 
           delete[] mergedTxns;
         } else {
@@ -244,21 +250,25 @@ namespace DB {
             auto it = childDiff.newSlots->begin();
 
             while (it != childDiff.newSlots->end()) {
-              int *   slotKey = &*it;
+              Key *   slotKey = &*it;
               page_id slotPID = *(it + W);
               seekKey(slotKey);
 
               if (node->isFull()) {
                 // We must split the node
+                int fill = pos == node->count && node->next == INVALID_PAGE
+                  ? Dim::APPEND_FILL
+                  : 50;
+
                 int nextNbr = nbr * SS;
                 newNbrs->insert(std::next(newNbrs->begin(), nextNbr), SS, 0);
-                page_id newNbr = node->split(pid, &(*newNbrs)[nextNbr]);
+                page_id newNbr = node->split(pid, &(*newNbrs)[nextNbr], fill);
                 (*newNbrs)[nextNbr + W] = newNbr;
                 continue;
               }
 
               node->makeRoom(pos, 1);
-              memmove(node->slot(pos), slotKey, W * sizeof(int));
+              memmove(node->slot(pos), slotKey, W * sizeof(Key));
               node->slot(pos)[W] = slotPID;
               it += SS;
             }
@@ -266,17 +276,17 @@ namespace DB {
             delete childDiff.newSlots;
           } else if(childDiff.prop == PROP_MERGE) {
             if (childDiff.sib == RIGHT_SIB) {
-              int toFree = node->slot(pos)[W];
+              page_id toFree = node->slot(pos)[W];
 
               node->makeRoom(pos + 1, -1);
               Global::BUFMGR->bfree(toFree);
             } else if (childDiff.sib == LEFT_SIB) {
-              int toFree = node->slot(pos)[-1];
+              page_id toFree = node->slot(pos)[-1];
 
               // Adopt the transaction buffer from the sibling, before it gets
               // deleted.
               memmove(node->txns(pos), node->txns(pos - 1),
-                      node->txnSpacePerChild() * sizeof(int));
+                      node->txnSpacePerChild() * sizeof(Key));
 
               node->makeRoom(pos, -1);
               Global::BUFMGR->bfree(toFree);
@@ -287,6 +297,8 @@ namespace DB {
         t = u;
       }
       break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
 
     if (!newNbrs->empty()) {
@@ -397,13 +409,15 @@ namespace DB {
         debugPrint(node->slot(i)[-1]);
 
       break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
 
     Global::BUFMGR->unpin(nid);
   }
 
   void
-  FTree::debugPrintTxns(int *txns, int txnSize, int width)
+  FTree::debugPrintTxns(Key *txns, int txnSize, int width)
   {
     int txnCount = txns[0];
 
@@ -419,7 +433,7 @@ namespace DB {
   }
 
   void
-  FTree::debugPrintKey(int *key, int width)
+  FTree::debugPrintKey(Key *key, int width)
   {
     std::cout << "(";
     for (int i = 0; i < width; ++i) {
@@ -430,7 +444,7 @@ namespace DB {
   }
 
   page_id
-  FTree::split(page_id pid, int *key)
+  FTree::split(page_id pid, Key *key, int fill)
   {
     // Allocate a new page
     char *page;
@@ -439,41 +453,44 @@ namespace DB {
     node->type  = type;
     node->width = width;
 
-    int pivot = count / 2;
+    int pivot = std::max(count / 2, count * fill / 100);
 
     switch (type) {
     case Leaf:
       // Move half the records.
       memmove(node->slot(0), slot(pivot),
-              (count - pivot) * stride() * sizeof(int));
+              (count - pivot) * stride() * sizeof(Key));
 
       // Move half the transaction buffer
       memmove(node->txns(count - pivot - 1),
               txns(count - 1),
-              (count - pivot) * txnSpacePerChild() * sizeof(int));
+              (count - pivot) * txnSpacePerChild() * sizeof(Key));
 
       node->count = count - pivot;
       count       = pivot;
 
       // Make a note of the pivot key
-      memmove(key, slot(pivot - 1), width * sizeof(int));
+      memmove(key, slot(pivot - 1), width * sizeof(Key));
       break;
     case Branch:
       // Move half the children, excluding the pivot key, which we push up.
+      pivot = std::min(pivot, count - 1);
       memmove(node->slot(0) - 1, slot(pivot + 1) - 1,
-              ((count - pivot - 1) * stride() + 1) * sizeof(int));
+              ((count - pivot - 1) * stride() + 1) * sizeof(Key));
 
       // Move half the transaction buffer
       memmove(node->txns(count - pivot - 1),
               txns(count),
-              (count - pivot) * txnSpacePerChild() * sizeof(int));
+              (count - pivot) * txnSpacePerChild() * sizeof(Key));
 
       node->count = count - pivot - 1;
       count       = pivot;
 
       // Make a note of the pivot key.
-      memmove(key, slot(pivot), width * sizeof(int));
+      memmove(key, slot(pivot), width * sizeof(Key));
       break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
 
     // Fix the neigbour pointers
@@ -492,30 +509,32 @@ namespace DB {
   }
 
   void
-  FTree::merge(page_id nid, FTree *that, int *part)
+  FTree::merge(page_id nid, FTree *that, Key *part)
   {
     switch (type) {
     case Leaf:
       memmove(slot(count), that->slot(0),
-              that->count * stride() * sizeof(int));
+              that->count * stride() * sizeof(Key));
 
       count += that->count;
       break;
     case Branch:
       // Move partitioning key onto the end.
-      memmove(slot(count), part, width * sizeof(int));
+      memmove(slot(count), part, width * sizeof(Key));
 
       // Move slots from neighbour
       memmove(slot(count + 1) - 1, that->slot(0) - 1,
-              (1 + that->count * stride()) * sizeof(int));
+              (1 + that->count * stride()) * sizeof(Key));
 
       // Move transactions from neighbour
       memmove(txns(count + that->count + 1),
               that->txns(that->count),
-              (that->count + 1) * txnSpacePerChild() * sizeof(int));
+              (that->count + 1) * txnSpacePerChild() * sizeof(Key));
 
       count += that->count + 1;
       break;
+    default:
+      throw std::runtime_error("Unrecognised Node Type");
     }
 
     // Fix neighbour pointers
@@ -534,22 +553,22 @@ namespace DB {
 
   NodeType FTree::getType()       const { return type; }
 
-  int *
+  Key *
   FTree::slot(int index)
   {
-    int *start = type == Leaf ? data : data + 1;
+    Key *start = type == Leaf ? data : data + 1;
     return start + stride() * index;
   }
 
-  int *
+  Key *
   FTree::txns(int index)
   {
-    int *end = &data[0] + SPACE;
+    Key *end = &data[0] + SPACE;
     return end - txnSpacePerChild() * (index + 1);
   }
 
   int
-  FTree::cmpKey(int *key1, int *key2, int width)
+  FTree::cmpKey(Key *key1, Key *key2, int width)
   {
     for (int i = 0; i < width; ++i) {
       if      (key1[i] < key2[i]) return -1;
@@ -559,13 +578,13 @@ namespace DB {
   }
 
   int
-  FTree::findKey(int *key, int from)
+  FTree::findKey(Key *key, int from)
   {
     int lo = from, hi = count;
 
     while(lo < hi) {
       int  m = lo + (hi - lo) / 2;
-      int *k = slot(m);
+      Key *k = slot(m);
 
       if (cmpKey(key, k, width) > 0)
         lo = m + 1;
@@ -577,13 +596,13 @@ namespace DB {
   }
 
   int
-  FTree::findNewSlot(const NewSlots &slots, int *key)
+  FTree::findNewSlot(const NewSlots &slots, Key *key)
   {
     int lo = 0, hi = slots->size() / stride();
 
     while(lo < hi) {
       int  m = lo + (hi - lo) / 2;
-      int *k = &((*slots)[m * stride()]);
+      Key *k = &((*slots)[m * stride()]);
 
       if (cmpKey(key, k, width) > 0)
         lo = m + 1;
@@ -595,7 +614,7 @@ namespace DB {
   }
 
   int
-  FTree::findTxn(int *txns, int width, int from, int *key)
+  FTree::findTxn(Key *txns, int width, int from, Key *key)
   {
     const int txnSize = TXN_HEADER_SIZE + width;
     int lo = from, hi = txns[0];
@@ -603,7 +622,7 @@ namespace DB {
     while(lo < hi) {
       int   m   = lo + (hi - lo) / 2;
       auto  txn = (Transaction *)&txns[txnSize * m + 1];
-      int  *k   = txn->data;
+      Key  *k   = txn->data;
 
       if (cmpKey(key, k, width) > 0)
         lo = m + 1;
@@ -614,15 +633,15 @@ namespace DB {
     return hi;
   }
 
-  int *
-  FTree::mergeTxns(int *existing, int *incoming, int incCount, int width)
+  Key *
+  FTree::mergeTxns(Key *existing, Key *incoming, int incCount, int width)
   {
     const int txnSize     = TXN_HEADER_SIZE + width;
-    const int byteTxnSize = txnSize * sizeof(int);
+    const int byteTxnSize = txnSize * sizeof(Key);
     const int extCount    = existing[0];
 
-    int *merged = new int[1 + (extCount + incCount) * txnSize]();
-    int &k      = merged[0];
+    Key *merged = new Key[1 + (extCount + incCount) * txnSize]();
+    Key &k      = merged[0];
 
     int i = 0, j = 0;
     while (i < extCount && j < incCount) {
@@ -669,12 +688,12 @@ namespace DB {
   {
     // Move slots
     memmove(slot(index + size), slot(index),
-            (count - index) * stride() * sizeof(int));
+            (count - index) * stride() * sizeof(Key));
 
     if (type == Branch) {
       // Move transactions
       memmove(txns(count + size), txns(count),
-              (count - index + 1) * txnSpacePerChild() * sizeof(int));
+              (count - index + 1) * txnSpacePerChild() * sizeof(Key));
 
       // Initialise counts of new transaction buffers.
       for (int i = index; i < index + size; ++i) {
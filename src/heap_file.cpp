@@ -19,7 +19,7 @@ namespace DB {
   }
 
   void
-  HeapFile::append(int *data, int len)
+  HeapFile::append(Key *data, int len)
   {
     // Check if there is enough space, and allocate a new page if there is not.
     if (mLastPage->count + len > PAGE_CAP) {
@@ -33,7 +33,7 @@ namespace DB {
     }
 
     memmove(&mLastPage->data[mLastPage->count], data,
-            len * sizeof(int));
+            len * sizeof(Key));
 
     mLastPage->count += len;
   }
@@ -5,6 +5,7 @@
 #include "bufmgr.h"
 #include "db.h"
 #include "dim.h"
+#include "ingest.h"
 #include "table.h"
 #include "test_bed.h"
 
@@ -36,8 +37,10 @@ main(int, char **)
     };
 
     cout << "Loading Data..." << endl;
-    R[1]->loadFromFile("data/R1.txt");
-    R[2]->loadFromFile("data/R2.txt");
+    DB::Ingest ingest;
+    ingest.add(R[1], "data/R1.txt");
+    ingest.add(R[2], "data/R2.txt");
+    ingest.run();
 
     cout << "Initialising Query..." << endl;
     DB::NaiveEquiJoin query(3, R);
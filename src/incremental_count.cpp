@@ -17,10 +17,8 @@ namespace DB {
 
     // Get fresh iterators.
     std::vector<TrieIterator::Ptr> iters;
-    for (const auto &kvp : getTables()) {
-      const auto &tbl = std::get<1>(kvp);
-      iters.emplace_back(tbl->scan());
-    }
+    for (const auto &kvp : getTables())
+      iters.emplace_back(scan(std::get<0>(kvp)));
 
     // Build a Join from them, and count the records in it.
     TrieIterator::Ptr query(new LeapFrogTrieJoin(getWidth(), move(iters)));
@@ -32,7 +30,8 @@ namespace DB {
   }
 
   void
-  IncrementalCount::updateView(int table, Op op, int x, int y, bool didChange)
+  IncrementalCount::updateView(int table, Op op, const Key *rec,
+                               bool didChange)
   {
     if (!didChange) {
 #ifdef DEBUG
@@ -41,21 +40,16 @@ namespace DB {
       return;
     }
 
-    // Get fresh iterators.
-    std::vector<TrieIterator::Ptr> iters;
-    for (const auto &kvp : getTables()) {
-      auto k          = std::get<0>(kvp);
-      const auto &tbl = std::get<1>(kvp);
-
-      // NB. Iterator for table that changed is a singleton.
-      iters.emplace_back(table == k ? tbl->singleton(x, y) : tbl->scan());
-    }
-
-    // Build a Join from them.
-    TrieIterator::Ptr query(new LeapFrogTrieJoin(getWidth(), move(iters)));
-
+    // Join the record against the other tables. NB. After an insert, the table
+    // already holds the record, so the joins for a self-join overlap.
     int delta = 0;
-    TrieIterator::countingScan(query, delta, getWidth());
+    joinDelta(table, op == Query::Insert,
+              [this, rec](int k) { return singleton(k, rec); },
+              [this, &delta](TrieIterator::Ptr &query, int sign) {
+                int count = 0;
+                TrieIterator::countingScan(query, count, getWidth());
+                delta += sign * count;
+              });
 
     switch (op) {
     case Query::Insert:
@@ -72,4 +66,27 @@ namespace DB {
               << delta << ")" << std::endl;
 #endif
   }
+
+  bool
+  IncrementalCount::purgeView(int table, Key lo, Key hi)
+  {
+    // Join the records to remove against the other tables (whilst they are
+    // still in the table).
+    int delta = 0;
+    joinDelta(table, true,
+              [this, lo, hi](int k) { return slice(k, lo, hi); },
+              [this, &delta](TrieIterator::Ptr &query, int sign) {
+                int count = 0;
+                TrieIterator::countingScan(query, count, getWidth());
+                delta += sign * count;
+              });
+
+    mCount -= delta;
+
+#ifdef DEBUG
+    std::cout << "|J| = " << mCount << "\t\t(-" << delta << ")" << std::endl;
+#endif
+
+    return false;
+  }
 }
@@ -9,8 +9,9 @@
 #include "trie_iterator.h"
 
 namespace DB {
-  IncrementalEquiJoin::IncrementalEquiJoin(int width, Tables tables)
-    : Query(width, move(tables))
+  IncrementalEquiJoin::IncrementalEquiJoin(int width, Tables tables,
+                                           Bindings bindings)
+    : Query(width, move(tables), move(bindings))
     , mJoin (width)
   {}
 
@@ -22,15 +23,13 @@ namespace DB {
 
     // Get fresh iterators.
     std::vector<TrieIterator::Ptr> iters;
-    for (const auto &kvp : getTables()) {
-      const auto &tbl = std::get<1>(kvp);
-      iters.emplace_back(tbl->scan());
-    }
+    for (const auto &kvp : getTables())
+      iters.emplace_back(scan(std::get<0>(kvp)));
 
     // Build a Join from them, and count the records in it.
     TrieIterator::Ptr query(new LeapFrogTrieJoin(getWidth(), move(iters)));
 
-    int *rec = new int[getWidth()]();
+    Key *rec = new Key[getWidth()]();
     TrieIterator::traverse(query, getWidth(), rec, [this, rec]() {
         mJoin.insert(rec);
       });
@@ -38,48 +37,62 @@ namespace DB {
   }
 
   void
-  IncrementalEquiJoin::updateView(int table, Op op, int x, int y, bool didChange)
+  IncrementalEquiJoin::updateView(int table, Op op, const Key *rec,
+                                  bool didChange)
   {
     if (!didChange) {
       return;
     }
 
-    // Get fresh iterators.
-    std::vector<TrieIterator::Ptr> iters;
-    for (const auto &kvp : getTables()) {
-      auto k          = std::get<0>(kvp);
-      const auto &tbl = std::get<1>(kvp);
-
-      // NB. Iterator for table that changed is a singleton.
-      iters.emplace_back(table == k ? tbl->singleton(x, y) : tbl->scan());
-    }
-
-    // Build a Join from them.
-    TrieIterator::Ptr query(new LeapFrogTrieJoin(getWidth(), move(iters)));
-
+    // Join the record against the other tables. NB. The joins for a self-join
+    // may find the same record more than once, but inserting or removing it
+    // from the view again does nothing.
     int txnsLogged = 0; // Used only in Debug mode.
-    int *rec = new int[getWidth()]();
-    TrieIterator::traverse(query, getWidth(), rec,
-                           [this, op, rec, &txnsLogged]() {
+    Key *recBuf = new Key[getWidth()]();
+    joinDelta(table, op == Insert,
+              [this, rec](int k) { return singleton(k, rec); },
+              [this, op, recBuf, &txnsLogged](TrieIterator::Ptr &query, int) {
+                TrieIterator::traverse(query, getWidth(), recBuf,
+                                       [this, op, recBuf, &txnsLogged]() {
 
 #ifdef DEBUG
-                             if (txnsLogged++ / 100 == 0)
-                               std::cout << "." << std::flush;
+                                         if (txnsLogged++ / 100 == 0)
+                                           std::cout << "." << std::flush;
 #endif
 
-                             switch (op) {
-                             case Insert:
-                               mJoin.insert(rec);
-                               break;
-                             case Delete:
-                               mJoin.remove(rec);
-                               break;
-                             }
-                           });
-    delete[] rec;
+                                         switch (op) {
+                                         case Insert:
+                                           mJoin.insert(recBuf);
+                                           break;
+                                         case Delete:
+                                           mJoin.remove(recBuf);
+                                           break;
+                                         }
+                                       });
+              });
+    delete[] recBuf;
 
 #ifdef DEBUG
     std::cout << std::endl;
 #endif
   }
+
+  bool
+  IncrementalEquiJoin::purgeView(int table, Key lo, Key hi)
+  {
+    // Join the records to remove against the other tables, and remove the
+    // records of those joins from the view.
+    Key *recBuf = new Key[getWidth()]();
+    joinDelta(table, true,
+              [this, lo, hi](int k) { return slice(k, lo, hi); },
+              [this, recBuf](TrieIterator::Ptr &query, int) {
+                TrieIterator::traverse(query, getWidth(), recBuf,
+                                       [this, recBuf]() {
+                                         mJoin.remove(recBuf);
+                                       });
+              });
+    delete[] recBuf;
+
+    return false;
+  }
 }
@@ -0,0 +1,199 @@
+#include "ingest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "dim.h"
+
+namespace DB {
+  Ingest::Ingest(int threads)
+    : mThreads ( threads > 0
+                 ? threads
+                 : std::max(1u, std::thread::hardware_concurrency()) )
+  {}
+
+  void
+  Ingest::add(std::shared_ptr<Table> table, const char *fname)
+  {
+    mSources.push_back({std::move(table), fname});
+  }
+
+  template <typename Task>
+  void
+  Ingest::parallel(int n, Task task)
+  {
+    std::atomic<int> next(0);
+    auto worker = [&] {
+      for (int i = next++; i < n; i = next++)
+        task(i);
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < std::min(mThreads, n); ++t)
+      workers.emplace_back(worker);
+
+    worker();
+    for (auto &w : workers)
+      w.join();
+  }
+
+  long
+  Ingest::run()
+  {
+    // Split the files into chunks.
+    std::vector<Chunk> chunks;
+    for (int s = 0; s < (int)mSources.size(); ++s) {
+      std::ifstream file(mSources[s].fname, std::ios::binary | std::ios::ate);
+      long size = file ? (long)file.tellg() : 0;
+
+      for (long from = 0; from < size; from += Dim::INGEST_CHUNK_SIZE) {
+        long to = std::min(size, from + Dim::INGEST_CHUNK_SIZE);
+        chunks.push_back({s, from, to, {}, true});
+      }
+    }
+
+    parallel(chunks.size(), [this, &chunks] (int c) {
+        const Source &source = mSources[chunks[c].source];
+        parse(source.fname, source.table->getWidth(), chunks[c]);
+      });
+
+    // Gather the chunks of each table's files, in order, up to the first line
+    // of each file that could not be parsed.
+    std::vector<std::shared_ptr<Table>> tables;
+    std::vector<std::vector<Chunk *>>   parts;
+    std::unordered_map<Table *, int>    slot;
+    std::vector<bool>                   stopped(mSources.size(), false);
+    for (auto &chunk : chunks) {
+      if (stopped[chunk.source])
+        continue;
+
+      stopped[chunk.source] = !chunk.ok;
+
+      auto &table = mSources[chunk.source].table;
+      auto it = slot.emplace(table.get(), tables.size()).first;
+      if (it->second == (int)tables.size()) {
+        tables.push_back(table);
+        parts.emplace_back();
+      }
+
+      parts[it->second].push_back(&chunk);
+    }
+
+    std::atomic<long> added(0);
+    parallel(tables.size(), [&tables, &parts, &added] (int t) {
+        std::vector<Key> recs;
+        for (Chunk *chunk : parts[t]) {
+          recs.insert(recs.end(), chunk->recs.begin(), chunk->recs.end());
+          std::vector<Key>().swap(chunk->recs);
+        }
+
+        added += tables[t]->insertBatch(recs);
+      });
+
+    mSources.clear();
+    return added;
+  }
+
+  void
+  Ingest::parse(const std::string &fname, int width, Chunk &chunk)
+  {
+    std::ifstream file(fname, std::ios::binary);
+
+    // Read from the byte before the chunk, to tell whether a line starts at
+    // the chunk's first byte.
+    long begin = chunk.from > 0 ? chunk.from - 1 : 0;
+    file.seekg(begin);
+
+    std::string buf(chunk.to - begin, '\0');
+    file.read(&buf[0], buf.size());
+    buf.resize(file.gcount());
+
+    // Finish the last line that starts in the chunk.
+    if (!buf.empty() && buf.back() != '\n') {
+      std::string rest;
+      std::getline(file, rest);
+      buf += rest;
+    }
+
+    size_t at = 0;
+    if (chunk.from > 0) {
+      at = buf.find('\n');
+      at = at == std::string::npos ? buf.size() : at + 1;
+    }
+
+    while (at < buf.size()) {
+      size_t eol = buf.find('\n', at);
+      if (eol == std::string::npos)
+        eol = buf.size();
+
+      if (!parseLine(&buf[at], &buf[0] + eol, width, chunk.recs)) {
+        chunk.ok = false;
+        return;
+      }
+
+      at = eol + 1;
+    }
+  }
+
+  bool
+  Ingest::parseLine(const char *p, const char *end, int width,
+                    std::vector<Key> &out)
+  {
+    auto skipSpace = [&] {
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        ++p;
+    };
+
+    skipSpace();
+    if (p == end)
+      return true;
+
+    const size_t mark = out.size();
+    auto fail = [&] {
+      out.resize(mark);
+      return false;
+    };
+
+    for (int i = 0; i < width; ++i) {
+      if (i > 0) {
+        skipSpace();
+        if (p == end || *p++ != ',')
+          return fail();
+        skipSpace();
+      }
+
+      bool neg = p < end && *p == '-';
+      if (neg || (p < end && *p == '+'))
+        ++p;
+
+      if (p == end || *p < '0' || *p > '9')
+        return fail();
+
+      // Accumulate unsigned, so that the smallest key does not overflow, and
+      // reject values that no key can hold.
+      using Mag = std::make_unsigned<Key>::type;
+      const Mag limit = neg ? (Mag)std::numeric_limits<Key>::max() + 1
+                            : (Mag)std::numeric_limits<Key>::max();
+
+      Mag val = 0;
+      while (p < end && *p >= '0' && *p <= '9') {
+        Mag digit = *p++ - '0';
+        if (val > (limit - digit) / 10)
+          return fail();
+
+        val = val * 10 + digit;
+      }
+
+      out.push_back(neg ? (Key)(0 - val) : (Key)val);
+    }
+
+    skipSpace();
+    return p == end || fail();
+  }
+}
@@ -10,10 +10,12 @@ namespace DB {
     : mJoinSize     ( joinSize )
     , mDepth        ( -1 )
     , mNextIter     ( 0 )
-    , mKey          ( std::numeric_limits<int>::min() )
+    , mKey          ( std::numeric_limits<Key>::min() )
     , mAtEnd        ( false )
     , mActiveIters  {}
     , mDormantIters (std::move(iters))
+    , mUseBits      ( false )
+    , mBitsBase     ( 0 )
   {}
 
   void
@@ -55,6 +57,14 @@ namespace DB {
   {
     if (!atValidDepth() || atEnd()) return;
 
+    if (mUseBits) {
+      if (mKey == std::numeric_limits<Key>::max())
+        mAtEnd = true;
+      else
+        seekBits(mKey + 1);
+      return;
+    }
+
     auto &iter = mActiveIters[mNextIter];
     iter->next();
 
@@ -67,10 +77,15 @@ namespace DB {
   }
 
   void
-  LeapFrogTrieJoin::seek(int searchKey)
+  LeapFrogTrieJoin::seek(Key searchKey)
   {
     if (!atValidDepth() || atEnd()) return;
 
+    if (mUseBits) {
+      seekBits(std::max(searchKey, mKey));
+      return;
+    }
+
     auto &iter = mActiveIters[mNextIter];
     iter->seek(searchKey);
 
@@ -82,14 +97,14 @@ namespace DB {
     }
   }
 
-  int
+  Key
   LeapFrogTrieJoin::key() const
   {
     if (!atValidDepth())
-      return std::numeric_limits<int>::min();
+      return std::numeric_limits<Key>::min();
 
     if (atEnd())
-      return std::numeric_limits<int>::max();
+      return std::numeric_limits<Key>::max();
 
     return mKey;
   }
@@ -145,7 +160,8 @@ namespace DB {
     mNextIter = 0;
 
     // Populate mKey with the next matching variable.
-    search();
+    if (!intersectBits())
+      search();
   }
 
   void
@@ -153,11 +169,11 @@ namespace DB {
   {
     int num    = mActiveIters.size();
     int prev   = (mNextIter - 1 + num) % num;
-    int maxKey = mActiveIters[prev]->key();
+    Key maxKey = mActiveIters[prev]->key();
 
     while(true) {
       auto &iter  = mActiveIters[mNextIter];
-      int nextKey = iter->key();
+      Key nextKey = iter->key();
       if (nextKey == maxKey) {
         // All the iterators are at the same key, we have found a match.
         mKey = nextKey;
@@ -175,4 +191,69 @@ namespace DB {
       }
     }
   }
+
+  bool
+  LeapFrogTrieJoin::intersectBits()
+  {
+    mUseBits = false;
+
+    // Only the last depth is intersected in one go, as deeper depths need the
+    // iterators to be positioned at each key in turn.
+    if (mDepth != mJoinSize - 1 || mActiveIters.size() < 2 || mAtEnd)
+      return false;
+
+    std::vector<TrieIterator::Bits> maps(mActiveIters.size());
+    for (std::size_t i = 0; i < maps.size(); ++i)
+      if (!mActiveIters[i]->bits(maps[i]))
+        return false;
+
+    // Keys must fall within every bitmap, and not before any iterator's
+    // current key. Spans are bounded by their last key (rather than the one
+    // after it), which is always a key itself.
+    Key lo   = std::numeric_limits<Key>::min();
+    Key hi   = std::numeric_limits<Key>::max();
+    Key from = std::numeric_limits<Key>::min();
+    for (std::size_t i = 0; i < maps.size(); ++i) {
+      lo   = std::max(lo, maps[i].base);
+      hi   = std::min(hi, (Key)(maps[i].base + (64 * maps[i].count - 1)));
+      from = std::max(from, mActiveIters[i]->key());
+    }
+
+    mUseBits  = true;
+    mBitsBase = lo;
+    mBits.assign(hi < lo ? 0 : ((uint64_t)hi - lo + 1) / 64, ~uint64_t(0));
+
+    for (auto &map : maps) {
+      const uint64_t *words = map.words + (lo - map.base) / 64;
+      for (std::size_t w = 0; w < mBits.size(); ++w)
+        mBits[w] &= words[w];
+    }
+
+    seekBits(from);
+    return true;
+  }
+
+  void
+  LeapFrogTrieJoin::seekBits(Key key)
+  {
+    uint64_t    off = key <= mBitsBase ? 0 : (uint64_t)key - mBitsBase;
+    std::size_t w   = off / 64;
+
+    if (w >= mBits.size()) {
+      mAtEnd = true;
+      return;
+    }
+
+    uint64_t word = mBits[w] & (~uint64_t(0) << (off % 64));
+    while (word == 0) {
+      if (++w == mBits.size()) {
+        mAtEnd = true;
+        return;
+      }
+
+      word = mBits[w];
+    }
+
+    mKey = mBitsBase + 64 * w + __builtin_ctzll(word);
+  }
 }
@@ -14,16 +14,14 @@ namespace DB {
 
     // Get fresh iterators.
     std::vector<TrieIterator::Ptr> iters;
-    for (const auto &kvp : getTables()) {
-      const auto &tbl = std::get<1>(kvp);
-      iters.emplace_back(tbl->scan());
-    }
+    for (const auto &kvp : getTables())
+      iters.emplace_back(scan(std::get<0>(kvp)));
 
     // Build a Join query from them.
     TrieIterator::Ptr query(new LeapFrogTrieJoin(getWidth(), move(iters)));
 
     // Pour it out into a result file.
-    int *recBuf = new int[getWidth()]();
+    Key *recBuf = new Key[getWidth()]();
     TrieIterator::traverse(query, getWidth(), recBuf, [this, recBuf] {
 #ifdef DEBUG
         for (int i = 0; i < getWidth(); ++i)
@@ -0,0 +1,105 @@
+#include "page_versions.h"
+
+#include <cstring>
+#include <limits>
+
+#include "bufmgr.h"
+#include "db.h"
+#include "dim.h"
+
+namespace DB {
+  PageVersions::PageVersions()
+    : mEpoch ( 0 )
+  {}
+
+  PageVersions::~PageVersions()
+  {
+    reclaim(std::numeric_limits<int>::max());
+  }
+
+  int
+  PageVersions::enter()
+  {
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    mReaders.insert(++mEpoch);
+    return mEpoch;
+  }
+
+  void
+  PageVersions::leave(int epoch)
+  {
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    auto it = mReaders.find(epoch);
+    if (it == mReaders.end())
+      return;
+
+    mReaders.erase(it);
+    reclaim(mReaders.empty()
+            ? std::numeric_limits<int>::max()
+            : *mReaders.begin());
+  }
+
+  bool
+  PageVersions::preserve(page_id pid)
+  {
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    if (mReaders.empty())
+      return false;
+
+    // A single copy serves every reader that arrived since the last one.
+    int newest  = *mReaders.rbegin();
+    auto &chain = mVersions[pid];
+    if (!chain.empty() && chain.back().first >= newest)
+      return false;
+
+    char *copy;
+    page_id cid = Global::BUFMGR->bnew(copy);
+    char *page  = Global::BUFMGR->pin(pid);
+
+    memcpy(copy, page, Dim::PAGE_SIZE);
+
+    Global::BUFMGR->unpin(pid);
+    Global::BUFMGR->unpin(cid, true);
+
+    chain.emplace_back(newest, cid);
+    return true;
+  }
+
+  page_id
+  PageVersions::resolve(page_id pid, int epoch) const
+  {
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    auto it = mVersions.find(pid);
+    if (it == mVersions.end())
+      return pid;
+
+    for (const auto &version : it->second)
+      if (version.first >= epoch)
+        return version.second;
+
+    return pid;
+  }
+
+  void
+  PageVersions::reclaim(int epoch)
+  {
+    for (auto it = mVersions.begin(); it != mVersions.end();) {
+      auto &chain = it->second;
+
+      size_t stale = 0;
+      while (stale < chain.size() && chain[stale].first < epoch)
+        Global::BUFMGR->bfree(chain[stale++].second);
+
+      chain.erase(chain.begin(), chain.begin() + stale);
+
+      if (chain.empty())
+        it = mVersions.erase(it);
+      else
+        ++it;
+    }
+  }
+}
@@ -1,15 +1,28 @@
 #include "query.h"
 
+#include <algorithm>
 #include <chrono>
+#include <stdexcept>
+
+#include "leapfrog_triejoin.h"
 
 namespace DB {
-  Query::Query(int width, Tables tables)
-    : mWidth  ( width )
-    , mTables ( std::move(tables) )
-  {}
+  Query::Query(int width, Tables tables, Bindings bindings)
+    : mWidth    ( width )
+    , mTables   ( std::move(tables) )
+    , mBindings ( std::move(bindings) )
+  {
+    for (const auto &kvp : mBindings) {
+      auto it = mTables.find(kvp.first);
+      if (it == mTables.end())
+        throw std::runtime_error("Binding for an unknown table!");
+
+      it->second->addOrdering(kvp.second);
+    }
+  }
 
   long
-  Query::update(int table, Op op, int x, int y)
+  Query::update(int table, Op op, const Key *rec)
   {
     bool didChange = false;
 
@@ -17,10 +30,10 @@ namespace DB {
     if (it != mTables.end()) {
       switch (op) {
       case Query::Insert:
-        didChange = mTables[table]->insert(x, y);
+        didChange = mTables[table]->insert(rec);
         break;
       case Query::Delete:
-        didChange = mTables[table]->remove(x, y);
+        didChange = mTables[table]->remove(rec);
         break;
       }
     }
@@ -30,12 +43,114 @@ namespace DB {
     auto begin  = clock::now();
 
     // Update the view.
-    updateView(table, op, x, y, didChange);
+    updateView(table, op, rec, didChange);
 
     // Calculate Time taken.
     return std::chrono::duration_cast<us>(clock::now() - begin).count();
   }
 
+  long
+  Query::update(int table, Op op, Key x, Key y)
+  {
+    Key rec[] = {x, y};
+    return update(table, op, rec);
+  }
+
+  long
+  Query::removeAll(int table, Key x)
+  {
+    return removeRange(table, x, x);
+  }
+
+  long
+  Query::removeRange(int table, Key lo, Key hi)
+  {
+    auto it = mTables.find(table);
+    if (it == mTables.end())
+      return 0;
+
+    using us    = std::chrono::microseconds;
+    using clock = std::chrono::steady_clock;
+    auto begin  = clock::now();
+
+    // Update the view, before the records are gone.
+    bool mustRecompute = purgeView(table, lo, hi);
+    auto elapsed       = clock::now() - begin;
+
+    bool didChange = it->second->removeRange(lo, hi);
+
+    if (mustRecompute && didChange) {
+      begin = clock::now();
+      recompute();
+      elapsed += clock::now() - begin;
+    }
+
+    // Calculate Time taken.
+    return std::chrono::duration_cast<us>(elapsed).count();
+  }
+
+  void
+  Query::joinDelta(int table, bool present,
+                   const Delta &delta, const Visit &visit) const
+  {
+    auto changed = mTables.find(table);
+    if (changed == mTables.end())
+      return;
+
+    // The names the changed table is read under.
+    std::vector<int> names;
+    for (const auto &kvp : mTables)
+      if (kvp.second == changed->second)
+        names.push_back(kvp.first);
+
+    if (names.size() >= 8 * sizeof(unsigned))
+      throw std::runtime_error("Table is read under too many names!");
+
+    for (unsigned reads = 1; reads < (1u << names.size()); ++reads) {
+      std::vector<TrieIterator::Ptr> iters;
+      for (const auto &kvp : mTables) {
+        auto at   = std::find(names.begin(), names.end(), kvp.first);
+        bool read = at != names.end() && (reads >> (at - names.begin())) & 1;
+        iters.emplace_back(read ? delta(kvp.first) : scan(kvp.first));
+      }
+
+      // NB. When the table holds the change, a record reading it under `n`
+      // names is found by `2^n - 1` joins, which must sum to one.
+      int sign = present && __builtin_popcount(reads) % 2 == 0 ? -1 : 1;
+
+      TrieIterator::Ptr query(new LeapFrogTrieJoin(mWidth, move(iters)));
+      visit(query, sign);
+    }
+  }
+
+  TrieIterator::Ptr
+  Query::scan(int table) const
+  {
+    auto &tbl = mTables.at(table);
+    auto it   = mBindings.find(table);
+    return it == mBindings.end() ? tbl->scan() : tbl->scan(it->second);
+  }
+
+  TrieIterator::Ptr
+  Query::slice(int table, Key lo, Key hi) const
+  {
+    auto &tbl = mTables.at(table);
+    auto it   = mBindings.find(table);
+    return it == mBindings.end()
+      ? tbl->slice(lo, hi)
+      : tbl->slice(lo, hi, it->second);
+  }
+
+  TrieIterator::Ptr
+  Query::singleton(int table, const Key *rec) const
+  {
+    auto &tbl = mTables.at(table);
+    auto it   = mBindings.find(table);
+    return it == mBindings.end()
+      ? tbl->singleton(rec)
+      : tbl->singleton(rec, it->second);
+  }
+
   const Query::Tables &
   Query::getTables() const
   {
@@ -0,0 +1,80 @@
+#include "root_cache.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace DB {
+
+  RootCache::RootCache(int size)
+    : mEntries ( size, Entry { 0, INVALID_PAGE } )
+    , mHits    ( 0 )
+    , mMisses  ( 0 )
+  {
+    if (size <= 0 || (size & (size - 1)) != 0)
+      throw std::runtime_error("Cache size must be a power of two!");
+  }
+
+  bool
+  RootCache::lookup(Key key, page_id &pid)
+  {
+    const Entry &entry = slot(key);
+    if (entry.pid == INVALID_PAGE || entry.key != key) {
+      mMisses++;
+      return false;
+    }
+
+    mHits++;
+    pid = entry.pid;
+    return true;
+  }
+
+  void
+  RootCache::put(Key key, page_id pid)
+  {
+    slot(key) = Entry { key, pid };
+  }
+
+  void
+  RootCache::erase(Key key)
+  {
+    Entry &entry = slot(key);
+    if (entry.key == key)
+      entry.pid = INVALID_PAGE;
+  }
+
+  void
+  RootCache::clear()
+  {
+    for (auto &entry : mEntries)
+      entry.pid = INVALID_PAGE;
+  }
+
+  long
+  RootCache::getHits() const
+  {
+    return mHits;
+  }
+
+  long
+  RootCache::getMisses() const
+  {
+    return mMisses;
+  }
+
+  double
+  RootCache::getHitRate() const
+  {
+    long lookups = mHits + mMisses;
+    return lookups == 0 ? 0 : (double)mHits / lookups;
+  }
+
+  RootCache::Entry &
+  RootCache::slot(Key key)
+  {
+    // Multiplicative hashing, folding the high bits of the product (which
+    // depend on every bit of the key) down into the bits used to pick a slot.
+    uint64_t hash = (uint64_t)key * 0x9E3779B97F4A7C15u;
+    hash ^= hash >> 32;
+    return mEntries[hash & (mEntries.size() - 1)];
+  }
+}
@@ -1,17 +1,17 @@
 #include "singleton_iterator.h"
 
+#include <algorithm>
 #include <limits>
 #include <stdexcept>
+#include <utility>
 
 namespace DB {
-  SingletonIterator::SingletonIterator(int fst, int x, int snd, int y)
-    : mFst      ( fst )
-    , mX        ( x )
-    , mSnd      ( snd )
-    , mY        ( y )
-    , mDepth    ( -1 )
-    , mFstAtEnd ( false )
-    , mSndAtEnd ( false )
+  SingletonIterator::SingletonIterator(std::vector<int> order,
+                                       std::vector<Key> rec)
+    : mOrder ( std::move(order) )
+    , mRec   ( std::move(rec) )
+    , mDepth ( -1 )
+    , mAtEnd ( mOrder.size(), false )
   {}
 
   void
@@ -26,51 +26,57 @@ namespace DB {
   void SingletonIterator::up()   {
     mDepth--;
 
-    mFstAtEnd &= (mDepth >= mFst);
-    mSndAtEnd &= (mDepth >= mSnd);
+    for (std::size_t l = 0; l < mOrder.size(); ++l)
+      mAtEnd[l] = mAtEnd[l] && (mDepth >= mOrder[l]);
   }
 
   void
   SingletonIterator::next()
   {
-    mFstAtEnd |= (mDepth == mFst);
-    mSndAtEnd |= (mDepth == mSnd);
+    int l = level();
+    if (l >= 0) mAtEnd[l] = true;
   }
 
   void
-  SingletonIterator::seek(int searchKey)
+  SingletonIterator::seek(Key searchKey)
   {
-    mFstAtEnd |= mDepth == mFst && searchKey > mX;
-    mSndAtEnd |= mDepth == mSnd && searchKey > mY;
+    int l = level();
+    if (l >= 0 && searchKey > mRec[l]) mAtEnd[l] = true;
   }
 
-  int
+  Key
   SingletonIterator::key() const
   {
     if (atEnd())
-      return std::numeric_limits<int>::max();
+      return std::numeric_limits<Key>::max();
 
-    if (mDepth == mFst)
-      return mX;
-    if (mDepth == mSnd)
-      return mY;
+    int l = level();
+    if (l >= 0)
+      return mRec[l];
 
-    return std::numeric_limits<int>::min();
+    return std::numeric_limits<Key>::min();
   }
 
   bool
   SingletonIterator::atEnd() const
   {
-    return
-      (mDepth == mFst && mFstAtEnd) ||
-      (mDepth == mSnd && mSndAtEnd);
+    int l = level();
+    return l >= 0 && mAtEnd[l];
   }
 
   bool
   SingletonIterator::atValidDepth() const
   {
-    return
-      mDepth == mFst ||
-      mDepth == mSnd;
+    return level() >= 0;
+  }
+
+  int
+  SingletonIterator::level() const
+  {
+    auto it = std::lower_bound(mOrder.begin(), mOrder.end(), mDepth);
+    if (it == mOrder.end() || *it != mDepth)
+      return -1;
+
+    return it - mOrder.begin();
   }
 }
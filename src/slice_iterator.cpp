@@ -0,0 +1,70 @@
+#include "slice_iterator.h"
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace DB {
+  SliceIterator::SliceIterator(TrieIterator::Ptr it, int depth, Key lo, Key hi)
+    : mIt         ( std::move(it) )
+    , mSliceDepth ( depth )
+    , mLo         ( lo )
+    , mHi         ( hi )
+    , mDepth      ( -1 )
+  {}
+
+  void
+  SliceIterator::open()
+  {
+    if (atEnd())
+      throw std::runtime_error("open: iterator finished!");
+
+    mIt->open();
+    mDepth++;
+
+    // Skip over the keys before the slice.
+    if (mDepth == mSliceDepth)
+      mIt->seek(mLo);
+  }
+
+  void
+  SliceIterator::up()
+  {
+    mIt->up();
+    mDepth--;
+  }
+
+  void SliceIterator::next()               { mIt->next(); }
+  void SliceIterator::seek(Key searchKey)  { mIt->seek(searchKey); }
+
+  Key
+  SliceIterator::key() const
+  {
+    if (atEnd())
+      return std::numeric_limits<Key>::max();
+
+    return mIt->key();
+  }
+
+  bool
+  SliceIterator::atEnd() const
+  {
+    return
+      mIt->atEnd() ||
+      (mDepth == mSliceDepth && mIt->key() > mHi);
+  }
+
+  bool
+  SliceIterator::atValidDepth() const
+  {
+    return mIt->atValidDepth();
+  }
+
+  bool
+  SliceIterator::bits(Bits &out) const
+  {
+    // The bitmap is not clipped to the slice, so it is only shared at other
+    // depths.
+    return mDepth != mSliceDepth && mIt->bits(out);
+  }
+}
@@ -0,0 +1,35 @@
+#include "snapshot.h"
+
+#include <utility>
+
+#include "btrie_iterator.h"
+
+namespace DB {
+  Snapshot::Snapshot(std::shared_ptr<PageVersions> versions,
+                     page_id rootPID,
+                     std::vector<int> order)
+    : mVersions ( std::move(versions) )
+    , mRootPID  ( rootPID )
+    , mOrder    ( std::move(order) )
+    , mEpoch    ( mVersions->enter() )
+  {}
+
+  Snapshot::~Snapshot()
+  {
+    mVersions->leave(mEpoch);
+  }
+
+  TrieIterator::Ptr
+  Snapshot::scan()
+  {
+    BTrieIterator *it =
+      new BTrieIterator(mRootPID, mOrder, shared_from_this());
+    return TrieIterator::Ptr(it);
+  }
+
+  page_id
+  Snapshot::resolve(page_id pid) const
+  {
+    return mVersions->resolve(pid, mEpoch);
+  }
+}
@@ -1,7 +1,11 @@
 #include "table.h"
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <limits>
+#include <numeric>
+#include <string>
 #include <utility>
 #include <stdexcept>
 
@@ -9,158 +13,1112 @@
 #include "btrie.h"
 #include "btrie_iterator.h"
 #include "bufmgr.h"
+#include "container.h"
+#include "csr_iterator.h"
 #include "db.h"
 #include "singleton_iterator.h"
+#include "slice_iterator.h"
 #include "trie.h"
 
 namespace DB {
 
-  Table::Table(int order1, int order2)
-    : mRootPID    { BTrie::leaf(2) }
-    , mRootOrder  { std::min(order1, order2) }
-    , mSubOrder   { std::max(order1, order2) }
-    , mIsReversed { order1 > order2 }
+  Table::Table(std::vector<int> order, Engine engine)
+    : mRootPID { INVALID_PAGE }
+    , mWidth   ( order.size() )
+    , mOrder   ( order )
+    , mColumn  ( nesting(order) )
+    , mKeys    ( order.size() )
+    , mCache   ( Dim::ROOT_CACHE_SIZE )
+    , mVersions ( std::make_shared<PageVersions>() )
+    , mDefragAt ( 0 )
+    , mDefragStep ( Visit )
+  {
+    if (mWidth == 0)
+      throw std::runtime_error("Table must have atleast one column!");
+
+    std::sort(mOrder.begin(), mOrder.end());
+
+    if (engine == Memory)
+      mMemory.reset(new CSRTrie(mWidth));
+    else
+      mRootPID = BTrie::leaf(strideAt(0));
+  }
+
+  Table::Table(int order1, int order2, Engine engine)
+    : Table(std::vector<int> { order1, order2 }, engine)
   {}
 
+  int
+  Table::getWidth() const
+  {
+    return mWidth;
+  }
+
+  Table::Engine
+  Table::getEngine() const
+  {
+    return mMemory ? Memory : Paged;
+  }
+
+  const TableStats &
+  Table::getStats() const
+  {
+    return mStats;
+  }
+
+  const RootCache &
+  Table::getCache() const
+  {
+    return mCache;
+  }
+
+  int
+  Table::count(Key x)
+  {
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    // Deeper sub-indices only count their own level's keys, so wider tables,
+    // and tables whose first column is not outermost, defer to the stats.
+    if (mMemory || mWidth > 2 || levelOf(0) != 0)
+      return mStats.getDegree(x);
+
+    mKeys[0] = x;
+
+    page_id subPID;
+    if (cachedRoot(subPID))
+      return BTrie::size(subPID);
+
+    page_id lid; int pos;
+    BTrie::find(mRootPID, x, lid, pos);
+
+    BTrie *leaf  = BTrie::load(lid);
+    int    total = 0;
+    if (pos < leaf->getCount() && leaf->key(pos) == x) {
+      if (mWidth == 1)
+        total = 1;
+      else if (leaf->inlineCount(pos) > 0)
+        total = leaf->inlineCount(pos);
+      else
+        total = BTrie::size(leaf->val(pos));
+    }
+
+    Global::BUFMGR->unpin(lid);
+    return total;
+  }
+
   void
-  Table::loadFromFile(const char *fname)
+  Table::loadFromFile(const char *fname, Dictionary *dict)
   {
     std::ifstream file(fname);
 
-    int x, y; char c;
-    while ((file >> x >> c >> y) && c == ',')
-      insert(x, y);
+    // Records are inserted in batches, each sorted into the order the table
+    // nests its records, rather than one at a time, as they are read.
+    std::vector<Key> batch;
+    std::vector<Key> rec(mWidth);
+
+    auto add = [&] {
+      batch.insert(batch.end(), rec.begin(), rec.end());
+      if (batch.size() >= (size_t)Dim::LOAD_BATCH_SIZE * mWidth) {
+        insertBatch(batch);
+        batch.clear();
+      }
+    };
+
+    if (dict) {
+      std::string line;
+      while (std::getline(file, line)
+             && dict->encodeFields(line, mWidth, rec))
+        add();
+    } else {
+      while (file >> rec[0]) {
+        char c = ',';
+        for (int i = 1; i < mWidth && c == ','; ++i)
+          file >> c >> rec[i];
+
+        if (!file || c != ',')
+          break;
+
+        add();
+      }
+    }
+
+    if (!batch.empty())
+      insertBatch(batch);
   }
 
   bool
-  Table::insert(int x, int y)
+  Table::insert(const Key *rec)
   {
-    if (mIsReversed)
-      std::swap(x, y);
+    std::lock_guard<std::mutex> guard(mLatch);
+    return insertRecord(rec);
+  }
 
-    page_id rootLID; int rootPos;
-    auto rootSplit = BTrie::reserve(mRootPID, x, NO_SIBS, rootLID, rootPos);
+  bool
+  Table::insert(Key x, Key y)
+  {
+    Key rec[] = {x, y};
+    return insert(rec);
+  }
 
-    // If no insertion was needed.
-    if (rootSplit.prop == PROP_NOTHING) {
-      BTrie * rootLeaf = BTrie::load(rootLID);
-      page_id subPID   = rootLeaf->slot(rootPos)[1];
+  int
+  Table::insertBatch(const std::vector<Key> &recs)
+  {
+    const int n = recs.size() / mWidth;
 
-      page_id subLID; int subPos;
-      auto subSplit = BTrie::reserve(subPID, y, NO_SIBS, subLID, subPos);
+    auto rec = [&] (int i) { return &recs[(size_t)i * mWidth]; };
 
-      // A split occurred in the sub index, so we need to create a new root node
-      // for it and replace the slot in the leaf of the root index
-      if (subSplit.prop == PROP_SPLIT) {
-        rootLeaf->slot(rootPos)[1] =
-          BTrie::branch(subPID, subSplit.key, subSplit.pid);
+    auto less = [&] (int a, int b) {
+      for (int c : mColumn)
+        if (rec(a)[c] != rec(b)[c])
+          return rec(a)[c] < rec(b)[c];
+      return false;
+    };
 
-        Global::BUFMGR->unpin(rootLID, true);
-      } else {
-        Global::BUFMGR->unpin(rootLID);
-      }
+    // Sort before taking the latch, so that the table may still be updated
+    // whilst the batch is being sorted.
+    std::vector<int> index(n);
+    std::iota(index.begin(), index.end(), 0);
+    std::sort(index.begin(), index.end(), less);
+
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    if (mMemory)
+      return insertBatchInMemory(recs, index);
+
+    int added = 0;
+    for (int i = 0; i < n; ++i) {
+      if (i > 0 && !less(index[i - 1], index[i]))
+        continue;
 
-      return subSplit.prop != PROP_NOTHING;
+      if (insertRecord(rec(index[i])))
+        ++added;
     }
 
-    // Otherwise the reservation caused an insertion.
+    return added;
+  }
 
-    // Update the root PID if we had to split it.
-    if (rootSplit.prop == PROP_SPLIT) {
-      mRootPID = BTrie::branch(mRootPID, rootSplit.key, rootSplit.pid);
+  int
+  Table::insertBatchInMemory(const std::vector<Key> &recs,
+                             const std::vector<int> &index)
+  {
+    // Rebuild the arrays once, with the records permuted into levels.
+    std::vector<Key> sorted;
+    sorted.reserve(recs.size());
+    for (int i : index) {
+      permute(&recs[(size_t)i * mWidth]);
+      if (sorted.size() > 0
+          && std::equal(mKeys.begin(), mKeys.end(), sorted.end() - mWidth))
+        continue;
+
+      sorted.insert(sorted.end(), mKeys.begin(), mKeys.end());
+    }
+
+    std::vector<Key> added;
+    mMemory->insertBatch(sorted, added);
+
+    // Put the new records' columns back in their own order.
+    std::vector<Key> fresh(added.size());
+    for (size_t r = 0; r < added.size(); r += mWidth) {
+      for (int l = 0; l < mWidth; ++l)
+        fresh[r + mColumn[l]] = added[r + l];
+
+      mStats.recordAdded(fresh[r]);
     }
 
-    // We must create a new sub index to fill this slot, and put the `y` in
-    // there.
-    page_id newLID = BTrie::leaf(1);
+    for (auto &ordering : mOrderings)
+      ordering->insertBatch(fresh);
+
+    return added.size() / mWidth;
+  }
+
+  bool
+  Table::remove(const Key *rec)
+  {
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    return removeRecord(rec);
+  }
+
+  bool
+  Table::remove(Key x, Key y)
+  {
+    Key rec[] = {x, y};
+    return remove(rec);
+  }
+
+  bool
+  Table::removeAll(Key x)
+  {
+    return removeRange(x, x);
+  }
+
+  bool
+  Table::insertRecord(const Key *rec)
+  {
+    BTrie::Writer writer(mVersions.get());
+
+    permute(rec);
+
+    // Hot keys skip the top level, unless their sub-index's root moves.
+    bool    didChange;
+    page_id subPID;
+    if (mMemory) {
+      didChange = mMemory->insert(mKeys);
+    } else if (cachedRoot(subPID)) {
+      page_id oldPID = subPID;
+      didChange = insertAt(subPID, 1);
+
+      if (subPID != oldPID)
+        relink(subPID);
+    } else {
+      didChange = insertAt(mRootPID, 0);
+    }
 
-    page_id subLID; int subPos;
-    BTrie::reserve(newLID, y, NO_SIBS, subLID, subPos);
+    if (!didChange)
+      return false;
 
-    // Then we update the leaf with the page_id of the new sub index.
-    BTrie * rootLeaf = BTrie::load(rootLID);
-    rootLeaf->slot(rootPos)[1] = newLID;
-    Global::BUFMGR->unpin(rootLID, true);
+    for (auto &ordering : mOrderings)
+      ordering->insert(rec);
 
+    mStats.recordAdded(rec[0]);
     return true;
   }
 
   bool
-  Table::remove(int x, int y)
+  Table::removeRecord(const Key *rec)
   {
-    if (mIsReversed)
-      std::swap(x, y);
+    BTrie::Writer writer(mVersions.get());
 
-    bool didChange = false;
-    BTrie::deleteIf(mRootPID, x, { .sibs = NO_SIBS },
-                    [&didChange, y] (page_id rootLID, int rootPos) {
-                      BTrie *rootLeaf = BTrie::load(rootLID);
-                      page_id subPID  = rootLeaf->slot(rootPos)[1];
-
-                      // Delete the key in the sub-index.
-                      BTrie::deleteIf(subPID, y, { .sibs = NO_SIBS },
-                                      [&didChange] (page_id, int) {
-                                        didChange = true;
-                                        return true;
-                                      });
-
-                      // Deal with the Sub-Index having an empty root.
-                      BTrie *sub = BTrie::load(subPID);
-
-                      if (sub->isEmpty()) {
-                        switch (sub->getType()) {
-                        case Leaf:
-                          // Delete this sub-index entirely.
-                          Global::BUFMGR->unpin(subPID);
-                          Global::BUFMGR->bfree(subPID);
-
-                          Global::BUFMGR->unpin(rootLID);
-                          return true;
-                        case Branch:
-                          // Replace the branch with its only child.
-                          rootLeaf->slot(rootPos)[1] = sub->slot(0)[-1];
-
-                          Global::BUFMGR->unpin(subPID);
-                          Global::BUFMGR->bfree(subPID);
-
-                          Global::BUFMGR->unpin(rootLID, true);
-                          return false;
-                        }
-                      }
-
-                      Global::BUFMGR->unpin(subPID);
-                      Global::BUFMGR->unpin(rootLID);
-                      return false;
-                    });
-
-    // Deal with the Root Index having an empty root node.
-    BTrie *root = BTrie::load(mRootPID);
-    if (root->isEmpty() && root->getType() == Branch) {
-      // Replace the branch with its only child.
-      page_id newRoot = root->slot(0)[-1];
-      Global::BUFMGR->unpin(mRootPID);
-      Global::BUFMGR->bfree(mRootPID);
-      mRootPID = newRoot;
+    permute(rec);
+
+    // Hot keys skip the top level, as long as their sub-index cannot be
+    // emptied, which would remove the key from the top level too. When the top
+    // level holds the first column, the key's degree says as much, without
+    // reading the sub-index.
+    bool    didChange;
+    page_id subPID;
+    if (mMemory) {
+      didChange = mMemory->remove(mKeys);
+    } else if (cachedRoot(subPID)
+               && (mColumn[0] == 0
+                     ? mStats.getDegree(rec[0]) > 1
+                     : BTrie::size(subPID) > 1)) {
+      page_id oldPID = subPID;
+      didChange = removeAt(subPID, 1);
+
+      if (subPID != oldPID)
+        relink(subPID);
     } else {
-      Global::BUFMGR->unpin(mRootPID);
+      didChange = removeAt(mRootPID, 0);
     }
 
+    if (!didChange)
+      return false;
+
+    for (auto &ordering : mOrderings)
+      ordering->remove(rec);
+
+    mStats.recordRemoved(rec[0]);
+    return true;
+  }
+
+  bool
+  Table::removeRange(Key lo, Key hi)
+  {
+    if (lo > hi)
+      return false;
+
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    for (auto &ordering : mOrderings)
+      ordering->removeRange(lo, hi);
+
+    if (mMemory) {
+      bool didChange = mMemory->removeRange(levelOf(0), lo, hi) > 0;
+      mStats.rangeRemoved(lo, hi);
+      return didChange;
+    }
+
+    BTrie::Writer writer(mVersions.get());
+    mCache.clear();
+
+    // If the first column is buried beneath other levels, there are no whole
+    // sub-indices to drop, so find the matching records and remove them one at
+    // a time.
+    if (mColumn[0] != 0) {
+      std::vector<Key> recs;
+      collect(mRootPID, 0, lo, hi, recs);
+
+      for (size_t r = 0; r < recs.size(); r += mWidth) {
+        std::copy(recs.begin() + r, recs.begin() + r + mWidth, mKeys.begin());
+        removeAt(mRootPID, 0);
+      }
+
+      mStats.rangeRemoved(lo, hi);
+      return !recs.empty();
+    }
+
+    auto destroy = [this] (page_id lid, int pos) {
+      if (mWidth == 1)
+        return true;
+
+      BTrie *leaf = BTrie::load(lid);
+      if (leaf->inlineCount(pos) == 0)
+        BTrie::destroy(leaf->val(pos));
+
+      Global::BUFMGR->unpin(lid);
+      return true;
+    };
+
+    // Each leaf the range spans has all of its keys in range deleted at once.
+    bool didChange = false;
+    Key  from      = lo;
+    for (bool more = true; more;) {
+      int  removed = 0;
+      auto diff    = BTrie::deleteRange(mRootPID, from, hi, { .sibs = NO_SIBS },
+                                        destroy, removed, more);
+      if (diff.prop == PROP_MERGE)
+        collapseRoot(mRootPID);
+
+      didChange |= removed > 0;
+    }
+
+    mStats.rangeRemoved(lo, hi);
     return didChange;
   }
 
+  DefragReport
+  Table::defragment(int budget)
+  {
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    DefragReport report {};
+    if (mMemory) {
+      report.done = true;
+      return report;
+    }
+
+    BTrie::Writer writer(mVersions.get());
+
+    while (report.visited < budget) {
+      int  left = budget - report.visited;
+      bool finished;
+
+      if (mDefragAt == 0) {
+        finished = defragTrie(left, report);
+      } else {
+        DefragReport sub = mOrderings[mDefragAt - 1]->defragment(left);
+        report.visited    += sub.visited;
+        report.moved      += sub.moved;
+        report.gapsBefore += sub.gapsBefore;
+        report.gapsAfter  += sub.gapsAfter;
+        finished = sub.done;
+      }
+
+      if (!finished)
+        break;
+
+      mDefragAt = (mDefragAt + 1) % (mOrderings.size() + 1);
+      if (mDefragAt == 0) {
+        report.done = true;
+        break;
+      }
+    }
+
+    return report;
+  }
+
+  bool
+  Table::defragTrie(int budget, DefragReport &report)
+  {
+    const long until = report.visited + budget;
+
+    while (report.visited < until) {
+      if (mDefragStep == Visit) {
+        page_id pid = subIndexAt(mDefragPath);
+        if (pid != INVALID_PAGE
+            && !BTrie::defragment(pid, mDefrag, until - report.visited, report))
+          return false;
+
+        // The sub-index has been visited (or is gone), so move on.
+        mDefrag     = BTrie::Defrag();
+        mDefragStep = Descend;
+      }
+
+      if (!nextSubIndex(until, report)) {
+        mDefragPath.clear();
+        mDefragStep = Visit;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  page_id
+  Table::subIndexAt(const std::vector<Key> &path)
+  {
+    page_id pid = mRootPID;
+    for (Key key : path) {
+      page_id lid; int pos;
+      BTrie::find(pid, key, lid, pos);
+
+      BTrie *leaf  = (BTrie *)Global::BUFMGR->pin(lid);
+      bool   found = pos < leaf->getCount()
+        && leaf->key(pos) == key
+        && leaf->inlineCount(pos) == 0;
+
+      pid = found ? (page_id)leaf->val(pos) : INVALID_PAGE;
+      Global::BUFMGR->unpin(lid);
+
+      if (!found)
+        return INVALID_PAGE;
+    }
+
+    return pid;
+  }
+
+  bool
+  Table::nextSubIndex(long until, DefragReport &report)
+  {
+    // Sub-indices are visited in pre-order: the sub-indices under the keys of
+    // the current one come first, then those after it under its parent.
+    Key  from    = std::numeric_limits<Key>::min();
+    bool descend = mDefragStep == Descend;
+
+    for (;;) {
+      if (report.visited >= until) {
+        mDefragStep = descend ? Descend : Ascend;
+        return true;
+      }
+
+      if (descend && (int)mDefragPath.size() >= mWidth - 1)
+        descend = false;
+
+      if (!descend) {
+        if (mDefragPath.empty())
+          return false;
+
+        Key key = mDefragPath.back();
+        mDefragPath.pop_back();
+
+        if (key == std::numeric_limits<Key>::max())
+          continue;
+
+        from = key + 1;
+      }
+
+      descend = false;
+
+      page_id pid = subIndexAt(mDefragPath);
+      if (pid == INVALID_PAGE)
+        continue;
+
+      // Find the first key from `from` whose sub-index has pages of its own.
+      page_id lid; int pos;
+      BTrie::find(pid, from, lid, pos);
+      while (lid != INVALID_PAGE) {
+        BTrie *leaf  = (BTrie *)Global::BUFMGR->pin(lid);
+        int    count = leaf->getCount();
+
+        for (; pos < count; ++pos) {
+          if (leaf->inlineCount(pos) == 0) {
+            mDefragPath.push_back(leaf->key(pos));
+            mDefragStep = Visit;
+            Global::BUFMGR->unpin(lid);
+            return true;
+          }
+        }
+
+        page_id next = leaf->getNext();
+        bool    skip = count > 0 && leaf->key(count - 1) >= from;
+        Key     last = skip ? leaf->key(count - 1) : from;
+        Global::BUFMGR->unpin(lid);
+        report.visited++;
+
+        // Out of budget: stop at the leaf's last key, whose sub-index is
+        // inline, so the next call carries on after it.
+        if (skip && next != INVALID_PAGE && report.visited >= until) {
+          mDefragPath.push_back(last);
+          mDefragStep = Ascend;
+          return true;
+        }
+
+        lid = next;
+        pos = 0;
+      }
+    }
+  }
+
   TrieIterator::Ptr
   Table::scan()
   {
-    BTrieIterator *it = new BTrieIterator(mRootPID, mRootOrder, mSubOrder);
+    if (mMemory) {
+      CSRIterator *it = new CSRIterator(*mMemory, mOrder);
+      return TrieIterator::Ptr(it);
+    }
+
+    BTrieIterator *it = new BTrieIterator(mRootPID, mOrder);
     return TrieIterator::Ptr(it);
   }
 
   TrieIterator::Ptr
-  Table::singleton(int x, int y)
+  Table::slice(Key lo, Key hi)
+  {
+    // The depth in the global ordering of the first column.
+    int depth = mOrder[levelOf(0)];
+
+    SliceIterator *it = new SliceIterator(scan(), depth, lo, hi);
+    return TrieIterator::Ptr(it);
+  }
+
+  std::shared_ptr<Snapshot>
+  Table::snapshot()
+  {
+    if (mMemory)
+      throw std::runtime_error("Snapshots need the paged engine!");
+
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    return std::make_shared<Snapshot>(mVersions, mRootPID, mOrder);
+  }
+
+  TrieIterator::Ptr
+  Table::singleton(const Key *rec)
   {
-    if (mIsReversed) std::swap(x, y);
+    permute(rec);
 
-    SingletonIterator *it = new SingletonIterator(mRootOrder, x, mSubOrder, y);
+    SingletonIterator *it = new SingletonIterator(mOrder, mKeys);
     return TrieIterator::Ptr(it);
   }
+
+  TrieIterator::Ptr
+  Table::singleton(Key x, Key y)
+  {
+    Key rec[] = {x, y};
+    return singleton(rec);
+  }
+
+  void
+  Table::addOrdering(const std::vector<int> &order)
+  {
+    if ((int)order.size() != mWidth)
+      throw std::runtime_error("Ordering must cover every column!");
+
+    std::lock_guard<std::mutex> guard(mLatch);
+
+    std::vector<int> column = nesting(order);
+    if (column == mColumn)
+      return;
+
+    for (auto &ordering : mOrderings)
+      if (ordering->mColumn == column)
+        return;
+
+    std::unique_ptr<Table> ordering(new Table(order, getEngine()));
+
+    // Copy the records over, with their columns back in their own order.
+    std::vector<Key> recs;
+    if (mMemory)
+      recs = mMemory->records();
+    else
+      collect(mRootPID, 0,
+              std::numeric_limits<Key>::min(),
+              std::numeric_limits<Key>::max(),
+              recs);
+
+    std::vector<Key> batch(recs.size());
+    for (size_t r = 0; r < recs.size(); r += mWidth)
+      for (int l = 0; l < mWidth; ++l)
+        batch[r + mColumn[l]] = recs[r + l];
+
+    ordering->insertBatch(batch);
+
+    mOrderings.emplace_back(std::move(ordering));
+  }
+
+  TrieIterator::Ptr
+  Table::scan(const std::vector<int> &order)
+  {
+    Table &table = orderedBy(order);
+
+    std::vector<int> positions(order);
+    std::sort(positions.begin(), positions.end());
+
+    if (table.mMemory) {
+      CSRIterator *it = new CSRIterator(*table.mMemory, positions);
+      return TrieIterator::Ptr(it);
+    }
+
+    BTrieIterator *it = new BTrieIterator(table.mRootPID, positions);
+    return TrieIterator::Ptr(it);
+  }
+
+  TrieIterator::Ptr
+  Table::slice(Key lo, Key hi, const std::vector<int> &order)
+  {
+    SliceIterator *it = new SliceIterator(scan(order), order[0], lo, hi);
+    return TrieIterator::Ptr(it);
+  }
+
+  TrieIterator::Ptr
+  Table::singleton(const Key *rec, const std::vector<int> &order)
+  {
+    std::vector<int> column = nesting(order);
+    std::vector<Key> keys(mWidth);
+    for (int l = 0; l < mWidth; ++l)
+      keys[l] = rec[column[l]];
+
+    std::vector<int> positions(order);
+    std::sort(positions.begin(), positions.end());
+
+    SingletonIterator *it = new SingletonIterator(positions, keys);
+    return TrieIterator::Ptr(it);
+  }
+
+  void
+  Table::permute(const Key *rec)
+  {
+    for (int l = 0; l < mWidth; ++l)
+      mKeys[l] = rec[mColumn[l]];
+  }
+
+  std::vector<int>
+  Table::nesting(const std::vector<int> &order)
+  {
+    // Levels are nested in the order their columns appear in the global
+    // ordering.
+    std::vector<int> column(order.size());
+    std::iota(column.begin(), column.end(), 0);
+    std::sort(column.begin(), column.end(),
+              [&order](int c, int d) { return order[c] < order[d]; });
+
+    return column;
+  }
+
+  Table &
+  Table::orderedBy(const std::vector<int> &order)
+  {
+    std::vector<int> column = nesting(order);
+    if (column == mColumn)
+      return *this;
+
+    for (auto &ordering : mOrderings)
+      if (ordering->mColumn == column)
+        return *ordering;
+
+    throw std::runtime_error("No ordering of the table matches!");
+  }
+
+  int
+  Table::levelOf(int column) const
+  {
+    return std::find(mColumn.begin(), mColumn.end(), column) - mColumn.begin();
+  }
+
+  int
+  Table::strideAt(int level) const
+  {
+    // The last level holds only keys, and the level above it holds the last
+    // level's sub-indices inline, when they are small enough.
+    if (level == mWidth - 1)
+      return 1;
+    else if (level == mWidth - 2)
+      return 2 + Dim::INLINE_SIZE;
+    else
+      return 2;
+  }
+
+  bool
+  Table::insertAt(page_id &pid, int level)
+  {
+    bool boxChange;
+    if (level > 0 && level == mWidth - 1 && insertBoxed(pid, boxChange))
+      return boxChange;
+
+    page_id lid; int pos;
+    auto split = BTrie::reserve(pid, mKeys[level], NO_SIBS, lid, pos,
+                                level == 0
+                                  ? Dim::APPEND_FILL
+                                  : Dim::SUB_APPEND_FILL);
+
+    // Update the root PID if we had to split it.
+    if (split.prop == PROP_SPLIT) {
+      pid = BTrie::branch(pid, split.key, split.pid);
+    }
+
+    if (level == mWidth - 1)
+      return split.prop != PROP_NOTHING;
+
+    BTrie * leaf  = BTrie::load(lid);
+    bool    isNew = split.prop != PROP_NOTHING;
+    bool    dirty = isNew;
+
+    if (level == mWidth - 2) {
+      const Key y = mKeys[level + 1];
+
+      // If the reservation caused an insertion, we start a new sub index,
+      // inline in the slot, and put the `y` in there.
+      if (isNew) {
+        leaf->setInlineCount(pos, 1);
+        leaf->inlineKey(pos, 0) = y;
+        Global::BUFMGR->unpin(lid, true);
+        return true;
+      }
+
+      // Otherwise, if the existing sub index is inline, add `y` to it.
+      int inlined = leaf->inlineCount(pos);
+      if (inlined > 0) {
+        int j = 0;
+        while (j < inlined && leaf->inlineKey(pos, j) < y)
+          j++;
+
+        if (j < inlined && leaf->inlineKey(pos, j) == y) {
+          Global::BUFMGR->unpin(lid);
+          return false;
+        }
+
+        if (inlined < Dim::INLINE_SIZE) {
+          for (int k = inlined; k > j; --k)
+            leaf->inlineKey(pos, k) = leaf->inlineKey(pos, k - 1);
+
+          leaf->inlineKey(pos, j) = y;
+          leaf->setInlineCount(pos, inlined + 1);
+          Global::BUFMGR->unpin(lid, true);
+          return true;
+        }
+
+        // The sub index has outgrown its slot, so move it into a page of its
+        // own, before adding `y` to it below.
+        page_id newLID = BTrie::leaf(1);
+
+        page_id subLID; int subPos;
+        for (int k = 0; k < inlined; ++k)
+          BTrie::reserve(newLID, leaf->inlineKey(pos, k), NO_SIBS,
+                         subLID, subPos);
+
+        leaf->val(pos) = newLID;
+        dirty = true;
+      }
+    }
+
+    // We must create a new sub index to fill this slot if there isn't one
+    // already, and insert the rest of the record there.
+    page_id subPID = isNew
+      ? BTrie::leaf(strideAt(level + 1))
+      : leaf->val(pos);
+
+    bool didChange = insertAt(subPID, level + 1);
+
+    // Then we update the leaf with the page_id of the (possibly new) root of
+    // the sub index.
+    if (isNew || leaf->val(pos) != (Key)subPID) {
+      leaf->val(pos) = subPID;
+      dirty = true;
+    }
+
+    if (level == 0)
+      mCache.put(mKeys[0], subPID);
+
+    Global::BUFMGR->unpin(lid, dirty);
+    return isNew || didChange;
+  }
+
+  bool
+  Table::removeAt(page_id &pid, int level)
+  {
+    bool didChange = false;
+    if (level > 0 && level == mWidth - 1 && removeBoxed(pid, didChange))
+      return didChange;
+
+    auto removeSlot = [this, level, &didChange] (page_id lid, int pos) {
+      if (level == mWidth - 1) {
+        didChange = true;
+        return true;
+      }
+
+      BTrie *leaf = BTrie::load(lid);
+
+      // Delete the key from an inline sub-index.
+      int inlined = leaf->inlineCount(pos);
+      if (inlined > 0) {
+        const Key y = mKeys[level + 1];
+
+        int j = 0;
+        while (j < inlined && leaf->inlineKey(pos, j) < y)
+          j++;
+
+        if (j == inlined || leaf->inlineKey(pos, j) != y) {
+          Global::BUFMGR->unpin(lid);
+          return false;
+        }
+
+        didChange = true;
+        for (int k = j + 1; k < inlined; ++k)
+          leaf->inlineKey(pos, k - 1) = leaf->inlineKey(pos, k);
+
+        // Delete the slot along with its last key.
+        if (inlined == 1) {
+          Global::BUFMGR->unpin(lid);
+          return true;
+        }
+
+        leaf->setInlineCount(pos, inlined - 1);
+        Global::BUFMGR->unpin(lid, true);
+        return false;
+      }
+
+      // Delete the rest of the record from the sub-index.
+      page_id subPID = leaf->val(pos);
+      didChange = removeAt(subPID, level + 1);
+
+      // Delete the sub-index entirely, if it is now empty.
+      BTrie *sub = BTrie::load(subPID);
+      if (sub->isEmpty()) {
+        Global::BUFMGR->unpin(subPID);
+        Global::BUFMGR->bfree(subPID);
+
+        if (level == 0)
+          mCache.erase(mKeys[0]);
+
+        Global::BUFMGR->unpin(lid);
+        return true;
+      }
+
+      Global::BUFMGR->unpin(subPID);
+
+      if (level == 0)
+        mCache.put(mKeys[0], subPID);
+
+      // Otherwise, its root may have changed.
+      if (leaf->val(pos) != (Key)subPID) {
+        leaf->val(pos) = subPID;
+        Global::BUFMGR->unpin(lid, true);
+      } else {
+        Global::BUFMGR->unpin(lid);
+      }
+
+      return false;
+    };
+
+    auto diff = BTrie::deleteIf(pid, mKeys[level], { .sibs = NO_SIBS },
+                                removeSlot);
+
+    // Deal with the index having an empty root node.
+    if (diff.prop == PROP_MERGE)
+      collapseRoot(pid);
+
+    return didChange;
+  }
+
+  bool
+  Table::cachedRoot(page_id &pid)
+  {
+    // Only sub-indices in pages of their own are cached.
+    return mWidth > 1 && mCache.lookup(mKeys[0], pid);
+  }
+
+  void
+  Table::relink(page_id pid)
+  {
+    page_id lid; int pos;
+    BTrie::find(mRootPID, mKeys[0], lid, pos);
+
+    BTrie *leaf = BTrie::load(lid);
+    leaf->val(pos) = pid;
+    Global::BUFMGR->unpin(lid, true);
+
+    mCache.put(mKeys[0], pid);
+  }
+
+  bool
+  Table::insertBoxed(page_id &pid, bool &didChange)
+  {
+    const Key y    = mKeys[mWidth - 1];
+    BTrie *   root = BTrie::load(pid);
+
+    if (Container::isContainer(root->getType())) {
+      Container *box = (Container *)root;
+      if (box->insert(y, didChange)) {
+        Global::BUFMGR->unpin(pid, didChange);
+        return true;
+      }
+
+      // The key is out of reach of the container's encoding.
+      std::vector<Key> keys;
+      box->keys(keys);
+      keys.insert(std::lower_bound(keys.begin(), keys.end(), y), y);
+
+      Global::BUFMGR->unpin(pid);
+      Global::BUFMGR->bfree(pid);
+
+      pid       = encode(keys, true);
+      didChange = true;
+      return true;
+    }
+
+    // A sub-index that is about to outgrow its only leaf is given a container
+    // instead, if one can hold it.
+    if (root->getType() == Leaf && root->isFull()) {
+      std::vector<Key> keys(&root->key(0), &root->key(0) + root->getCount());
+
+      auto it = std::lower_bound(keys.begin(), keys.end(), y);
+      if (it == keys.end() || *it != y) {
+        keys.insert(it, y);
+
+        page_id boxPID = Container::build(keys);
+        if (boxPID != INVALID_PAGE) {
+          Global::BUFMGR->unpin(pid);
+          Global::BUFMGR->bfree(pid);
+
+          pid       = boxPID;
+          didChange = true;
+          return true;
+        }
+      }
+    }
+
+    Global::BUFMGR->unpin(pid);
+    return false;
+  }
+
+  bool
+  Table::removeBoxed(page_id &pid, bool &didChange)
+  {
+    const Key y    = mKeys[mWidth - 1];
+    BTrie *   root = BTrie::load(pid);
+
+    if (!Container::isContainer(root->getType())) {
+      Global::BUFMGR->unpin(pid);
+      return false;
+    }
+
+    Container *box  = (Container *)root;
+    bool       fits = box->remove(y, didChange);
+    if (fits && (!didChange || box->getCount() >= Container::MIN_COUNT)) {
+      Global::BUFMGR->unpin(pid, didChange);
+      return true;
+    }
+
+    // Either the deletion is out of reach of the container's encoding, or the
+    // container has thinned out enough to go back to being a BTrie.
+    std::vector<Key> keys;
+    box->keys(keys);
+    if (!fits)
+      keys.erase(std::lower_bound(keys.begin(), keys.end(), y));
+
+    Global::BUFMGR->unpin(pid);
+    Global::BUFMGR->bfree(pid);
+
+    pid       = encode(keys, !fits);
+    didChange = true;
+    return true;
+  }
+
+  page_id
+  Table::encode(const std::vector<Key> &keys, bool compact)
+  {
+    if (compact) {
+      page_id boxPID = Container::build(keys);
+      if (boxPID != INVALID_PAGE)
+        return boxPID;
+    }
+
+    // Keys are added in order, so leaves are filled as they go.
+    page_id pid = BTrie::leaf(1);
+    for (Key key : keys) {
+      page_id lid; int pos;
+      auto split = BTrie::reserve(pid, key, NO_SIBS, lid, pos,
+                                  Dim::SUB_APPEND_FILL);
+
+      if (split.prop == PROP_SPLIT)
+        pid = BTrie::branch(pid, split.key, split.pid);
+    }
+
+    return pid;
+  }
+
+  void
+  Table::collect(page_id pid, int level, Key lo, Key hi, std::vector<Key> &out)
+  {
+    // Only the level holding the first column is restricted to the range.
+    const bool isSliced = mColumn[level] == 0;
+    const Key  from     = isSliced ? lo : std::numeric_limits<Key>::min();
+    const Key  to       = isSliced ? hi : std::numeric_limits<Key>::max();
+
+    // Containers are read key by key.
+    BTrie *root = BTrie::load(pid);
+    if (Container::isContainer(root->getType())) {
+      Container *box = (Container *)root;
+
+      Key  key;
+      bool found = box->seek(from, key);
+      while (found && key <= to) {
+        mKeys[level] = key;
+        out.insert(out.end(), mKeys.begin(), mKeys.end());
+
+        found = key < std::numeric_limits<Key>::max()
+          && box->seek(key + 1, key);
+      }
+
+      Global::BUFMGR->unpin(pid);
+      return;
+    }
+
+    Global::BUFMGR->unpin(pid);
+
+    page_id lid; int pos;
+    BTrie::find(pid, from, lid, pos);
+    while (lid != INVALID_PAGE) {
+      BTrie *leaf  = BTrie::load(lid);
+      int    count = leaf->getCount();
+
+      for (; pos < count && leaf->key(pos) <= to; ++pos) {
+        mKeys[level] = leaf->key(pos);
+
+        if (level == mWidth - 1) {
+          out.insert(out.end(), mKeys.begin(), mKeys.end());
+          continue;
+        }
+
+        int inlined = leaf->inlineCount(pos);
+        if (inlined == 0) {
+          collect(leaf->val(pos), level + 1, lo, hi, out);
+          continue;
+        }
+
+        // Inline sub-indices only ever hold the last level.
+        const bool isLastSliced = mColumn[level + 1] == 0;
+        for (int j = 0; j < inlined; ++j) {
+          Key y = leaf->inlineKey(pos, j);
+          if (isLastSliced && (y < lo || hi < y))
+            continue;
+
+          mKeys[level + 1] = y;
+          out.insert(out.end(), mKeys.begin(), mKeys.end());
+        }
+      }
+
+      page_id next = pos == count ? leaf->getNext() : INVALID_PAGE;
+      Global::BUFMGR->unpin(lid);
+
+      lid = next;
+      pos = 0;
+    }
+  }
+
+  void
+  Table::collapseRoot(page_id &pid)
+  {
+    BTrie *root = BTrie::load(pid);
+    if (root->isEmpty() && root->getType() == Branch) {
+      // Replace the branch with its only child.
+      page_id newRoot = root->val(-1);
+      Global::BUFMGR->unpin(pid);
+      Global::BUFMGR->bfree(pid);
+      pid = newRoot;
+    } else {
+      Global::BUFMGR->unpin(pid);
+    }
+  }
 }
@@ -0,0 +1,87 @@
+#include "table_stats.h"
+
+namespace DB {
+  constexpr int TableStats::BUCKETS;
+
+  TableStats::TableStats()
+    : mCardinality ( 0 )
+    , mHistogram   ( BUCKETS, 0 )
+  {}
+
+  long
+  TableStats::getCardinality() const
+  {
+    return mCardinality;
+  }
+
+  int
+  TableStats::getDistinct() const
+  {
+    return mDegrees.size();
+  }
+
+  int
+  TableStats::getDegree(Key x) const
+  {
+    auto it = mDegrees.find(x);
+    return it == mDegrees.end() ? 0 : it->second;
+  }
+
+  const std::vector<long> &
+  TableStats::getHistogram() const
+  {
+    return mHistogram;
+  }
+
+  void
+  TableStats::recordAdded(Key x)
+  {
+    mCardinality++;
+
+    int &degree = mDegrees[x];
+    if (degree > 0)
+      mHistogram[bucket(degree)]--;
+
+    degree++;
+    mHistogram[bucket(degree)]++;
+  }
+
+  void
+  TableStats::recordRemoved(Key x)
+  {
+    auto it = mDegrees.find(x);
+    if (it == mDegrees.end())
+      return;
+
+    mCardinality--;
+    mHistogram[bucket(it->second)]--;
+
+    if (--it->second == 0)
+      mDegrees.erase(it);
+    else
+      mHistogram[bucket(it->second)]++;
+  }
+
+  void
+  TableStats::rangeRemoved(Key lo, Key hi)
+  {
+    if (lo > hi)
+      return;
+
+    auto begin = mDegrees.lower_bound(lo);
+    auto end   = mDegrees.upper_bound(hi);
+
+    for (auto it = begin; it != end; ++it) {
+      mCardinality -= it->second;
+      mHistogram[bucket(it->second)]--;
+    }
+
+    mDegrees.erase(begin, end);
+  }
+
+  int
+  TableStats::bucket(int degree)
+  {
+    return 31 - __builtin_clz(degree);
+  }
+}
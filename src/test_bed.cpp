@@ -2,12 +2,16 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "query.h"
 
 namespace DB {
-  TestBed::TestBed(Query &query)
+  TestBed::TestBed(Query &query, Dictionary *dict)
     : mQuery { query }
+    , mDict  { dict }
   {}
 
   long
@@ -17,18 +21,46 @@ namespace DB {
 
     long elapsed = 0;
 
-    int tn, x, y; char c1, c2;
-    while ((file >> tn >> c1 >> x >> c2 >> y) &&
-           (c1 == ',')                        &&
-           (c2 == ',')) {
+    std::string      line;
+    std::vector<Key> rec;
+    while (std::getline(file, line)) {
+      std::istringstream fields(line);
+
+      int tn; Key v; char c;
+      rec.clear();
+      if (!(fields >> tn)) break;
+
+      // The record must be exactly as wide as its table.
+      const auto &tables = mQuery.getTables();
+      auto it = tables.find(tn);
+      if (it == tables.end()) continue;
+
+      const int width = it->second->getWidth();
+      if (mDict) {
+        std::string rest;
+        if (!((fields >> c) && c == ','
+              && std::getline(fields, rest)
+              && mDict->encodeFields(rest, width, rec)))
+          break;
+      } else {
+        while ((fields >> c >> v) && c == ',')
+          rec.push_back(v);
+
+        if ((int)rec.size() != width) break;
+      }
 
 #ifdef DEBUG
       std::cout << (op == Query::Insert ? '+' : '-')
-                << "R" << tn << "(" << x << "," << y << ")"
-                << std::endl;
+                << "R" << tn << "(";
+      if (mDict)
+        mDict->write(std::cout, rec.data(), rec.size());
+      else
+        for (std::size_t i = 0; i < rec.size(); ++i)
+          std::cout << (i == 0 ? "" : ",") << rec[i];
+      std::cout << ")" << std::endl;
 #endif
 
-      elapsed += mQuery.update(tn, op, x, y);
+      elapsed += mQuery.update(tn, op, rec.data());
     }
 
     return elapsed;
@@ -1,6 +1,12 @@
 #include "trie_iterator.h"
 
 namespace DB {
+  bool
+  TrieIterator::bits(Bits &) const
+  {
+    return false;
+  }
+
   void
   TrieIterator::countingScan(Ptr &it, int &count, int depth)
   {
@@ -18,7 +24,7 @@ namespace DB {
   }
 
   void
-  TrieIterator::traverse(Ptr &it, int depth, int *rec,
+  TrieIterator::traverse(Ptr &it, int depth, Key *rec,
                          std::function<void(void)> act,
                          int pos)
   {
@@ -19,8 +19,8 @@ namespace DB {
     Global::BUFMGR->unpin(mRootPID);
   }
 
-  void View::insert(int *data) { logTxn(FTree::Insert, data); }
-  void View::remove(int *data) { logTxn(FTree::Delete, data); }
+  void View::insert(Key *data) { logTxn(FTree::Insert, data); }
+  void View::remove(Key *data) { logTxn(FTree::Delete, data); }
 
   void
   View::clear()
@@ -28,15 +28,15 @@ namespace DB {
   }
 
   void
-  View::logTxn(FTree::TxnType msg, int *data)
+  View::logTxn(FTree::TxnType msg, Key *data)
   {
     // Build a buffer containing a single transaction.
-    int *txns = new int[1 + mTree->txnSize()]();
+    Key *txns = new Key[1 + mTree->txnSize()]();
     txns[0]   = 1;
     auto txn  = (FTree::Transaction *)&txns[1];
 
     txn->message = msg;
-    memmove(txn->data, data, mWidth * sizeof(int));
+    memmove(txn->data, data, mWidth * sizeof(Key));
 
     auto diff = FTree::flush(mRootPID, {.sibs = NO_SIBS}, txns);
     delete[] txns;
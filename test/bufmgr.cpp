@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "allocator.h"
+#include "bufmgr.h"
+#include "db.h"
+#include "dim.h"
+
+using namespace std;
+
+/**
+ * Tests for freeing pages through `DB::BufMgr::bfree`: pages pinned only by
+ * snapshot readers are freed once the last of them lets go, and are not reused
+ * until then, but freeing a page that is pinned any other way is an error.
+ */
+
+namespace {
+  int failures = 0;
+
+  void
+  check(bool ok, const char *what)
+  {
+    if (!ok) {
+      cerr << "FAIL: " << what << endl;
+      failures++;
+    }
+  }
+
+  bool
+  throws(void (*fn)(DB::page_id), DB::page_id pid)
+  {
+    try {
+      fn(pid);
+    } catch (runtime_error &) {
+      return true;
+    }
+
+    return false;
+  }
+
+  void bfree(DB::page_id pid) { DB::Global::BUFMGR->bfree(pid); }
+
+  // Whether the page is free on file, leaving it that way.
+  bool
+  isFree(DB::page_id pid)
+  {
+    if (DB::Global::ALLOC->pallocBetween(pid, pid + 1) != pid)
+      return false;
+
+    DB::Global::ALLOC->pfree(pid);
+    return true;
+  }
+}
+
+int
+main()
+{
+  try {
+    DB::Allocator a("test.db", DB::Dim::PAGE_SIZE, 100);
+    DB::BufMgr    b(10);
+
+    DB::Global::ALLOC  = &a;
+    DB::Global::BUFMGR = &b;
+
+    char *page;
+
+    // Pinned by its writer: freeing it is an error, and leaves it allocated.
+    DB::page_id pid = b.bnew(page);
+    check(throws(bfree, pid), "freeing a page its writer pins throws");
+    check(!isFree(pid), "a page that failed to be freed stays allocated");
+    b.unpin(pid);
+
+    bfree(pid);
+    check(isFree(pid), "an unpinned page is freed straight away");
+
+    // Pinned by readers alone: freed once the last of them unpins it.
+    pid = b.bnew(page);
+    b.unpin(pid, true);
+    b.pinForReader(pid);
+    b.pinForReader(pid);
+
+    check(!throws(bfree, pid), "freeing a page only readers pin succeeds");
+    check(!isFree(pid), "a page readers pin is not reused");
+
+    b.unpinForReader(pid);
+    check(!isFree(pid), "a page is not reused until every reader unpins it");
+
+    b.unpinForReader(pid);
+    check(isFree(pid), "a page is freed when its last reader unpins it");
+
+    // Pinned by a reader and its writer: freeing it is still an error.
+    pid = b.bnew(page);
+    b.pinForReader(pid);
+    check(throws(bfree, pid), "freeing a page its writer and a reader pin "
+                              "throws");
+
+    b.unpin(pid);
+    b.unpinForReader(pid);
+    bfree(pid);
+    check(isFree(pid), "the page is freed once both unpin it");
+
+    // Readers may only release their own pins.
+    pid = b.bnew(page);
+    try {
+      b.unpinForReader(pid);
+      check(false, "releasing a writer's pin as a reader throws");
+    } catch (runtime_error &) {}
+
+    b.unpin(pid);
+    bfree(pid);
+
+  } catch (exception &e) {
+    cerr << "bufmgr test terminated due to exception: " << e.what() << endl;
+    failures++;
+  }
+
+  remove("test.db");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocator.h"
+#include "bufmgr.h"
+#include "db.h"
+#include "dim.h"
+#include "ingest.h"
+#include "table.h"
+#include "trie_iterator.h"
+
+using namespace std;
+
+/**
+ * Tests for loading tables through `DB::Ingest`: a file is loaded up to its
+ * first line that is not a record, and columns whose values do not fit in a key
+ * end the load, rather than wrapping around.
+ */
+
+namespace {
+  int failures = 0;
+
+  void
+  check(bool ok, const char *what)
+  {
+    if (!ok) {
+      cerr << "FAIL: " << what << endl;
+      failures++;
+    }
+  }
+
+  vector<vector<DB::Key>>
+  load(const string &contents)
+  {
+    const char *fname = "test_ingest.csv";
+    ofstream(fname) << contents;
+
+    auto table = make_shared<DB::Table>(0, 1);
+
+    DB::Ingest ingest(1);
+    ingest.add(table, fname);
+    ingest.run();
+    remove(fname);
+
+    vector<vector<DB::Key>> recs;
+    DB::Key rec[2];
+    auto it = table->scan();
+    DB::TrieIterator::traverse(it, 2, rec, [&] {
+        recs.push_back({rec[0], rec[1]});
+      });
+
+    return recs;
+  }
+}
+
+int
+main()
+{
+  try {
+    DB::Allocator a("test.db", DB::Dim::PAGE_SIZE, 1000);
+    DB::BufMgr    b(100);
+
+    DB::Global::ALLOC  = &a;
+    DB::Global::BUFMGR = &b;
+
+    using Recs = vector<vector<DB::Key>>;
+    const DB::Key MIN = numeric_limits<DB::Key>::min();
+    const DB::Key MAX = numeric_limits<DB::Key>::max();
+
+    check(load("1,2\n 3 , 4 \n\n5,6\n") == Recs({{1, 2}, {3, 4}, {5, 6}}),
+          "well-formed records are loaded");
+
+    check(load("1,2\n3\n5,6\n") == Recs({{1, 2}}),
+          "loading stops at a short record");
+
+    check(load(to_string(MIN) + "," + to_string(MAX) + "\n")
+            == Recs({{MIN, MAX}}),
+          "the smallest and largest keys are loaded");
+
+    check(load("1,2\n3,99999999999999999999\n5,6\n") == Recs({{1, 2}}),
+          "loading stops at an over-long column");
+
+    // One past either end of the range of keys.
+    string above = to_string(MAX);
+    string below = to_string(MIN);
+    above.back()++;
+    below.back()++;
+
+    check(load("1,2\n" + above + ",4\n5,6\n") == Recs({{1, 2}}),
+          "loading stops at a column above the largest key");
+
+    check(load("1,2\n" + below + ",4\n5,6\n") == Recs({{1, 2}}),
+          "loading stops at a column below the smallest key");
+
+  } catch (exception &e) {
+    cerr << "ingest test terminated due to exception: " << e.what() << endl;
+    failures++;
+  }
+
+  remove("test.db");
+  return failures == 0 ? 0 : 1;
+}
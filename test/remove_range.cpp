@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "allocator.h"
+#include "bufmgr.h"
+#include "db.h"
+#include "dim.h"
+#include "table.h"
+#include "trie_iterator.h"
+
+using namespace std;
+
+/**
+ * Tests for `DB::Table::removeRange`, which deletes spans of keys from the top
+ * level of a table in bulk: every record in the range goes, across as many
+ * leaves as it spans, and every other record stays, for both engines, and
+ * whichever level the first column is nested at.
+ */
+
+namespace {
+  using Rec = pair<DB::Key, DB::Key>;
+
+  int failures = 0;
+
+  void
+  check(bool ok, const char *what)
+  {
+    if (!ok) {
+      cerr << "FAIL: " << what << endl;
+      failures++;
+    }
+  }
+
+  vector<Rec>
+  contents(DB::Table &table, bool swapped)
+  {
+    vector<Rec> recs;
+    DB::Key rec[2];
+    auto it = table.scan();
+    DB::TrieIterator::traverse(it, 2, rec, [&] {
+        recs.push_back(swapped ? Rec(rec[1], rec[0]) : Rec(rec[0], rec[1]));
+      });
+
+    sort(recs.begin(), recs.end());
+    return recs;
+  }
+
+  void
+  run(DB::Table::Engine engine, vector<int> order)
+  {
+    DB::Table table(order, engine);
+    set<Rec>  ref;
+    mt19937   rng(order[0] * 2 + engine);
+
+    for (int round = 0; round < 20; ++round) {
+      for (int i = 0; i < 10000; ++i) {
+        DB::Key rec[] = { (DB::Key)(rng() % 50000), (DB::Key)(rng() % 4) };
+        table.insert(rec);
+        ref.emplace(rec[0], rec[1]);
+      }
+
+      // Alternate between spans of many leaves, and of a few keys.
+      DB::Key lo = rng() % 50000;
+      DB::Key hi = lo + (round % 2 ? rng() % 30000 : rng() % 100);
+
+      bool any = false;
+      for (auto it = ref.lower_bound(Rec(lo, 0));
+           it != ref.end() && it->first <= hi;) {
+        it  = ref.erase(it);
+        any = true;
+      }
+
+      check(table.removeRange(lo, hi) == any,
+            "removing a range reports whether it held any records");
+      check(!table.removeRange(lo, hi),
+            "removing an empty range changes nothing");
+      check(contents(table, order[0] > order[1])
+              == vector<Rec>(ref.begin(), ref.end()),
+            "only the records in the range are removed");
+      check(table.getStats().getCardinality() == (long)ref.size(),
+            "stats agree with the records left");
+    }
+  }
+}
+
+int
+main()
+{
+  try {
+    DB::Allocator a("test.db", DB::Dim::PAGE_SIZE, 20000);
+    DB::BufMgr    b(100);
+
+    DB::Global::ALLOC  = &a;
+    DB::Global::BUFMGR = &b;
+
+    run(DB::Table::Paged,  {0, 1});
+    run(DB::Table::Paged,  {1, 0});
+    run(DB::Table::Memory, {0, 1});
+    run(DB::Table::Memory, {1, 0});
+
+  } catch (exception &e) {
+    cerr << "removeRange test terminated due to exception: " << e.what()
+         << endl;
+    failures++;
+  }
+
+  remove("test.db");
+  return failures == 0 ? 0 : 1;
+}